@@ -22,13 +22,17 @@ def configure(env):
 def get_doc_classes():
     return [
         "LuaAPI",
+        "LuaAPINative",
         "LuaCoroutine",
         "LuaError",
         "LuaTuple",
         "LuaCallableExtra",
         "LuaFunctionRef",
+        "LuaJob",
         "LuaObjectMetatable",
         "LuaDefaultObjectMetatable",
+        "LuaProcessGroup",
+        "LuaScheduler",
     ]
 
 def get_doc_path():
@@ -0,0 +1,59 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9964
+
+	lua = LuaAPI.new()
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.push_variants/pull_variants"
+	testDescription = "
+Pushes and pulls several globals, including dotted names, in one call each.
+Also checks errors are reported per name.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("player = {}")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var push_errors = lua.push_variants({
+		"score": 10,
+		"player.name": "weasel",
+		"player.position": Vector2(1, 2),
+		"missing.field": 5,
+		&"player.level": 3,
+	})
+
+	if push_errors.size() != 1 or not push_errors.get("missing.field") is LuaError:
+		errors.append(LuaError.new_error("Expected only missing.field to fail but got %s" % str(push_errors)))
+		return fail()
+
+	# Pull twice so the cached paths are used too
+	for i in range(2):
+		var values = lua.pull_variants(PackedStringArray(["score", "player.name", "player.position", "missing.field", "nothing", "player.level"]))
+		if values.size() != 6:
+			errors.append(LuaError.new_error("Expected 6 values but got %d" % values.size()))
+			return fail()
+
+		if values[0] != 10 or values[1] != "weasel" or values[2] != Vector2(1, 2) or values[5] != 3:
+			errors.append(LuaError.new_error("Pulled wrong values: %s" % str(values)))
+			return fail()
+
+		if values[3] != null or values[4] != null:
+			errors.append(LuaError.new_error("Missing names are not null: %s" % str(values)))
+			return fail()
+
+	done = true
@@ -0,0 +1,66 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9962
+
+	lua = LuaAPI.new()
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.call_function_batch"
+	testDescription = "
+Calls a function over rows of arguments and over packed columns.
+A failing call should be reported by index without stopping the rest of the batch.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("
+	function scale(a, b)
+		if a < 0 then
+			error('negative')
+		end
+		return a * b
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var results = []
+	var batchErrors = lua.call_function_batch("scale", [[1, 2], [-1, 2], [3, 4]], results)
+	if batchErrors is LuaError:
+		errors.append(batchErrors)
+		return fail()
+
+	if not (results.size() == 3 and results[0] == 2 and results[1] == null and results[2] == 12):
+		errors.append(LuaError.new_error("results are not [2, null, 12] but are '%s'" % str(results)))
+		return fail()
+
+	if not batchErrors.size() == 1 or not batchErrors[1] is LuaError:
+		errors.append(LuaError.new_error("expected a single error for call 1 but got '%s'" % str(batchErrors)))
+		return fail()
+
+	batchErrors = lua.call_function_batch("scale", [PackedFloat32Array([1, 2, 3]), PackedFloat32Array([2, 2, 2])], results)
+	if batchErrors is LuaError:
+		errors.append(batchErrors)
+		return fail()
+
+	if not (results.size() == 3 and results[0] == 2 and results[1] == 4 and results[2] == 6) or not batchErrors.is_empty():
+		errors.append(LuaError.new_error("column results are not [2, 4, 6] but are '%s'" % str(results)))
+		return fail()
+
+	if not lua.call_function_batch("missing", [[1]], results) is LuaError:
+		errors.append(LuaError.new_error("call_function_batch on a missing function did not return a LuaError"))
+		return fail()
+
+	done = true
@@ -0,0 +1,85 @@
+extends UnitTest
+var lua: LuaAPI
+var counter: Counter
+
+class Counter:
+	var finalized: int = 0
+
+class Finalized:
+	var counter: Counter
+
+	func _init(c: Counter):
+		counter = c
+
+	func __gc(_lua: LuaAPI):
+		counter.finalized += 1
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9780
+
+	lua = LuaAPI.new()
+	lua.deferred_finalization = true
+	lua.finalizer_budget_count = 2
+	counter = Counter.new()
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.deferred_finalization"
+	testDescription = "
+Pushes 5 objects defining __gc, drops them in lua and forces a collection.
+No finalizer should run until drain_finalizers is called.
+With a budget of 2 the queue should take 3 drains to empty.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	for i in range(5):
+		var err = lua.push_variant("obj%d" % i, Finalized.new(counter))
+		if err is LuaError:
+			errors.append(err)
+			return fail()
+
+	var err = lua.do_string("obj0, obj1, obj2, obj3, obj4 = nil, nil, nil, nil, nil")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	lua.configure_gc(LuaAPI.GC_COLLECT, 0)
+
+	if not counter.finalized == 0:
+		errors.append(LuaError.new_error("finalized is not 0 before draining but is '%d'" % counter.finalized))
+		return fail()
+
+	if not lua.get_pending_finalizer_count() == 5:
+		errors.append(LuaError.new_error("pending finalizers is not 5 but is '%d'" % lua.get_pending_finalizer_count()))
+		return fail()
+
+	var drains = 0
+	while lua.get_pending_finalizer_count() > 0:
+		var ran = lua.drain_finalizers()
+		if ran > 2:
+			errors.append(LuaError.new_error("drain_finalizers ran '%d' finalizers with a budget of 2" % ran))
+			return fail()
+		drains += 1
+
+	if not drains == 3:
+		errors.append(LuaError.new_error("drains is not 3 but is '%d'" % drains))
+		return fail()
+
+	if not counter.finalized == 5:
+		errors.append(LuaError.new_error("finalized is not 5 but is '%d'" % counter.finalized))
+		return fail()
+
+	if not lua.get_peak_finalizer_count() == 5:
+		errors.append(LuaError.new_error("peak finalizers is not 5 but is '%d'" % lua.get_peak_finalizer_count()))
+		return fail()
+
+	done = true
@@ -0,0 +1,80 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9969
+
+	lua = LuaAPI.new()
+	lua.bind_libraries(["base"])
+	lua.set_execution_limit(100000, 0)
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.execution_limit"
+	testDescription = "
+Stops runaway scripts with set_execution_limit, both by raising an error and by yielding coroutines.
+"
+
+func fail():
+	status = false
+	done = true
+
+func expect_limit_error(code: String) -> bool:
+	var err = lua.do_string(code)
+	if not (err is LuaError) or err.type != LuaError.ERR_EXECUTION_LIMIT:
+		errors.append(LuaError.new_error("Expected an execution limit error from '%s' but got %s" % [code, str(err)]))
+		return false
+	return true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	if not expect_limit_error("while true do end"):
+		return fail()
+
+	# Catching the error does not get around the limit
+	if not expect_limit_error("while true do pcall(function() while true do end end) end"):
+		return fail()
+
+	# Every call gets a fresh limit
+	var ret = lua.do_string("local n = 0 for i=1,100 do n = n + i end return n")
+	if ret != 5050:
+		errors.append(LuaError.new_error("Expected 5050 but got %s" % str(ret)))
+		return fail()
+
+	lua.execution_limit_yields = true
+	var co = lua.new_coroutine()
+	co.load_string("
+	local n = 0
+	while n < 1000000 do
+		n = n + 1
+	end
+	return n
+	")
+
+	var resumes = 0
+	var results = null
+	while not co.is_done():
+		resumes += 1
+		var res = co.resume([])
+		if res is LuaError:
+			if res.type != LuaError.ERR_EXECUTION_LIMIT:
+				errors.append(res)
+				return fail()
+		else:
+			results = res
+
+	if resumes < 2 or results != [1000000]:
+		errors.append(LuaError.new_error("Expected the coroutine to yield at the limit, got %s after %d resumes" % [str(results), resumes]))
+		return fail()
+
+	lua.set_execution_limit(0, 0)
+	ret = lua.do_string("local n = 0 while n < 1000000 do n = n + 1 end return n")
+	if ret != 1000000:
+		errors.append(LuaError.new_error("Expected the limit to be removed, got %s" % str(ret)))
+		return fail()
+
+	done = true
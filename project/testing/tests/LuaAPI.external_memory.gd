@@ -0,0 +1,47 @@
+extends UnitTest
+var lua: LuaAPI
+var image: Image
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9785
+
+	lua = LuaAPI.new()
+	lua.report_external_memory = true
+	image = Image.create(512, 512, false, Image.FORMAT_RGBA8)
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.external_memory"
+	testDescription = "
+Pushes a 1MB image 32 times into the same global without ever collecting from Lua.
+The reported size alone should drive the collector, so most of the old handles are gone.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var size = image.get_data().size()
+	for i in range(32):
+		var err = lua.push_variant("img", image)
+		if err is LuaError:
+			errors.append(err)
+			return fail()
+
+	var used = lua.get_external_memory_usage()
+	if used < size:
+		errors.append(LuaError.new_error("Expected the live image to be reported but usage is %d" % used))
+		return fail()
+
+	# Without the reported size the tiny userdata would never trigger a collection
+	if used >= size * 8:
+		errors.append(LuaError.new_error("Expected old images to be collected but usage is %d" % used))
+		return fail()
+
+	done = true
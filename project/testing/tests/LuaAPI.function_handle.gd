@@ -0,0 +1,63 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9965
+
+	lua = LuaAPI.new()
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.function_handle"
+	testDescription = "
+Resolves ai.tick with get_function_handle and calls it with invoke and invoke_direct.
+Repeated calls must not leave anything behind on the stack.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("
+	ai = {}
+	function ai.tick(a, b)
+		return a + b
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var handle = lua.get_function_handle("ai.tick")
+	if handle is LuaError:
+		errors.append(handle)
+		return fail()
+
+	var ret = handle.invoke([2, 3])
+	if not ret == 5:
+		errors.append(LuaError.new_error("handle.invoke returned '%s' instead of 5" % str(ret)))
+		return fail()
+
+	ret = handle.invoke_direct(4, 5)
+	if not ret == 9:
+		errors.append(LuaError.new_error("handle.invoke_direct returned '%s' instead of 9" % str(ret)))
+		return fail()
+
+	if not lua.get_function_handle("ai.missing") is LuaError:
+		errors.append(LuaError.new_error("get_function_handle on a missing function did not return a LuaError"))
+		return fail()
+
+	# The handle must not leave anything behind on the stack between calls
+	for i in range(10):
+		ret = handle.invoke_direct(i, 1)
+		if not ret == i + 1:
+			errors.append(LuaError.new_error("handle.invoke_direct returned '%s' instead of %d on repeated calls" % [str(ret), i + 1]))
+			return fail()
+
+	done = true
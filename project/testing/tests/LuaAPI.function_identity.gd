@@ -0,0 +1,52 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9975
+
+	lua = LuaAPI.new()
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.function_identity"
+	testDescription = "
+Pulls the same Lua function several times.
+The Callables should compare equal and hash the same, and LuaFunctionRefs should be the same object.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("
+	function callback() end
+	function other() end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var a = lua.pull_variant("callback")
+	var b = lua.pull_variant("callback")
+	if not a == b or not a.hash() == b.hash():
+		errors.append(LuaError.new_error("pulling the same function twice gave Callables that are not equal"))
+		return fail()
+
+	if a == lua.pull_variant("other"):
+		errors.append(LuaError.new_error("Callables to different functions compared equal"))
+		return fail()
+
+	lua.use_callables = false
+	var refA = lua.pull_variant("callback")
+	var refB = lua.pull_variant("callback")
+	if not refA == refB:
+		errors.append(LuaError.new_error("pulling the same function twice gave different LuaFunctionRefs"))
+		return fail()
+
+	done = true
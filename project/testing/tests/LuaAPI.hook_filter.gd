@@ -0,0 +1,72 @@
+extends UnitTest
+var lua: LuaAPI
+var lines: Array = []
+var calls: int = 0
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9973
+
+	lua = LuaAPI.new()
+	lua.bind_libraries(["base"])
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.hook_filter"
+	testDescription = "
+Filters line and call events natively with set_hook_filter so the hook only sees breakpoints and chosen functions.
+"
+
+func fail():
+	status = false
+	done = true
+
+func line_hook(_parent: LuaAPI, _event: int, line: int):
+	lines.append(line)
+
+func call_hook(_parent: LuaAPI, _event: int, _line: int):
+	calls += 1
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	lua.set_hook(line_hook, LuaAPI.HOOK_MASK_LINE, 0)
+	lua.set_hook_filter({"": [4]})
+	var err = lua.do_string("
+	local n = 0
+	for i=1,5 do
+		n = n + i
+	end
+	return n
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if lines != [4, 4, 4, 4, 4]:
+		errors.append(LuaError.new_error("Expected the hook to only see line 4 five times but got %s" % str(lines)))
+		return fail()
+
+	# A new hook keeps the filter, the function names filter call events
+	lua.set_hook(call_hook, LuaAPI.HOOK_MASK_CALL, 0)
+	lua.set_hook_filter({}, ["target"])
+	err = lua.do_string("
+	function target() end
+	function other() end
+	for i=1,3 do
+		target()
+		other()
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if calls != 3:
+		errors.append(LuaError.new_error("Expected 3 filtered calls but got %d" % calls))
+		return fail()
+
+	lua.set_hook(Callable(), 0, 0)
+	done = true
@@ -0,0 +1,95 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9963
+
+	lua = LuaAPI.new()
+	lua.push_variant("bounds", _bounds)
+	lua.push_variant("nested", _nested)
+	lua.push_variant("nested_bounds", _nested_bounds)
+	lua.push_variant("bad_return", _bad_return)
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.multiple_returns"
+	testDescription = "
+Reads every return value of a Lua function with call_function_into.
+Returns two values to Lua from GDScript with return_values.
+Checks exposed functions that call back into Lua still return their own values.
+"
+
+func _bounds():
+	lua.return_values(1, 10)
+
+# Calling back into Lua from a function Lua called must not change what it returns
+func _nested():
+	lua.do_string("return 1")
+	lua.call_function("three", [])
+	return 42
+
+func _nested_bounds():
+	lua.return_values(5, 6)
+	lua.do_string("return 1")
+	lua.call_function("three", [])
+
+var bad_return_result = null
+
+func _bad_return():
+	bad_return_result = lua.return_values(LuaError.new_error("not a value"))
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("
+	function three()
+		return 1, 'two', 3
+	end
+
+	low, high = bounds()
+	nested_value = nested()
+	nested_low, nested_high = nested_bounds()
+	bad_return()
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var results = []
+	err = lua.call_function_into("three", [], results)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if not (results.size() == 3 and results[0] == 1 and results[1] == "two" and results[2] == 3):
+		errors.append(LuaError.new_error("results are not [1, 'two', 3] but are '%s'" % str(results)))
+		return fail()
+
+	if not lua.pull_variant("low") == 1 or not lua.pull_variant("high") == 10:
+		errors.append(LuaError.new_error("low and high are not 1 and 10 but are '%s' and '%s'" % [str(lua.pull_variant("low")), str(lua.pull_variant("high"))]))
+		return fail()
+
+	if lua.pull_variant("nested_value") != 42:
+		errors.append(LuaError.new_error("nested() returned '%s' instead of 42" % str(lua.pull_variant("nested_value"))))
+		return fail()
+
+	if lua.pull_variant("nested_low") != 5 or lua.pull_variant("nested_high") != 6:
+		errors.append(LuaError.new_error("nested_bounds() did not return 5 and 6"))
+		return fail()
+
+	if not (bad_return_result is LuaError):
+		errors.append(LuaError.new_error("return_values with a LuaError did not return a LuaError"))
+		return fail()
+
+	if not lua.return_values(1) is LuaError:
+		errors.append(LuaError.new_error("return_values outside of a call from Lua did not return a LuaError"))
+		return fail()
+
+	done = true
@@ -0,0 +1,112 @@
+extends UnitTest
+var lua: LuaAPI
+
+const PRODUCERS = 4
+const EVENTS = 1000
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9974
+
+	lua = LuaAPI.new()
+	lua.bind_libraries(["base"])
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.post_event"
+	testDescription = "
+Posts events from several threads at once and drains them into a Lua handler in batches.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _produce(producer: int):
+	for i in range(EVENTS):
+		lua.post_event(producer * 100000 + i)
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("
+	received = 0
+	batches = 0
+	out_of_order = 0
+	local last = {}
+	function on_events(events, count)
+		batches = batches + 1
+		for i=1,count do
+			local n = events[i] % 100000
+			local producer = (events[i] - n) / 100000
+			if last[producer] ~= nil and n <= last[producer] then
+				out_of_order = out_of_order + 1
+			end
+			last[producer] = n
+			received = received + 1
+		end
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var threads: Array = []
+	for p in range(PRODUCERS):
+		var thread = Thread.new()
+		thread.start(_produce.bind(p))
+		threads.append(thread)
+	for thread in threads:
+		thread.wait_to_finish()
+
+	if lua.get_pending_event_count() != PRODUCERS * EVENTS:
+		errors.append(LuaError.new_error("Expected %d pending events but got %d" % [PRODUCERS * EVENTS, lua.get_pending_event_count()]))
+		return fail()
+
+	var first = lua.drain_events("on_events", 1500)
+	var rest = lua.drain_events("on_events")
+	if first != 1500 or rest != PRODUCERS * EVENTS - 1500:
+		errors.append(LuaError.new_error("Expected batches of 1500 and %d but got %s and %s" % [PRODUCERS * EVENTS - 1500, str(first), str(rest)]))
+		return fail()
+
+	if lua.pull_variant("received") != PRODUCERS * EVENTS or lua.pull_variant("batches") != 2:
+		errors.append(LuaError.new_error("Expected every event in two batches"))
+		return fail()
+
+	if lua.pull_variant("out_of_order") != 0:
+		errors.append(LuaError.new_error("Expected the events of each producer to stay in order"))
+		return fail()
+
+	# Nothing queued, the handler is not called
+	if lua.drain_events("on_events") != 0 or lua.pull_variant("batches") != 2:
+		errors.append(LuaError.new_error("Expected an empty drain to skip the handler"))
+		return fail()
+
+	# A LuaError can not be passed to Lua, it arrives as nil instead of bringing the state down
+	lua.post_event(LuaError.new_error("not an event"))
+	lua.post_event([LuaError.new_error("nested")])
+	err = lua.do_string("
+	function count_nils(events, count)
+		nils = 0
+		for i=1,count do
+			if events[i] == nil then nils = nils + 1 end
+		end
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if lua.drain_events("count_nils") != 2 or lua.pull_variant("nils") != 2:
+		errors.append(LuaError.new_error("Expected both LuaError events to arrive as nil"))
+		return fail()
+
+	lua.post_event("oops")
+	var failed = lua.drain_events("on_events")
+	if not (failed is LuaError) or lua.get_pending_event_count() != 0:
+		errors.append(LuaError.new_error("Expected the handler error to be returned and the event dequeued"))
+		return fail()
+
+	done = true
@@ -0,0 +1,70 @@
+extends UnitTest
+var lua: LuaAPI
+var watchdog: Thread
+var finished := false
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9971
+
+	lua = LuaAPI.new()
+	lua.bind_libraries(["base"])
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.request_interrupt"
+	testDescription = "
+Stops an endless loop with request_interrupt called from another thread.
+Catching the interrupt with pcall does not keep the script running.
+"
+
+func fail():
+	status = false
+	done = true
+
+# Keeps asking until the loop is stopped, requests made before do_string starts are ignored
+func _watch():
+	while not finished:
+		lua.request_interrupt()
+		OS.delay_msec(5)
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	# Nothing is running, so this does nothing
+	lua.request_interrupt()
+	var ret = lua.do_string("return 1")
+	if ret != 1:
+		errors.append(LuaError.new_error("Expected an interrupt while idle to be ignored but got %s" % str(ret)))
+		return fail()
+
+	watchdog = Thread.new()
+	watchdog.start(_watch)
+	var err = lua.do_string("while true do end")
+	finished = true
+	watchdog.wait_to_finish()
+
+	if not (err is LuaError) or err.type != LuaError.ERR_EXECUTION_LIMIT or not ("interrupted" in err.message):
+		errors.append(LuaError.new_error("Expected the loop to be interrupted but got %s" % str(err)))
+		return fail()
+
+	# The interrupt stays raised until do_string returns, no matter how often pcall catches it
+	finished = false
+	watchdog = Thread.new()
+	watchdog.start(_watch)
+	err = lua.do_string("while true do pcall(function() while true do end end) end")
+	finished = true
+	watchdog.wait_to_finish()
+
+	if not (err is LuaError) or err.type != LuaError.ERR_EXECUTION_LIMIT:
+		errors.append(LuaError.new_error("Expected the pcall loop to be interrupted but got %s" % str(err)))
+		return fail()
+
+	ret = lua.do_string("return 2")
+	if ret != 2:
+		errors.append(LuaError.new_error("Expected the next call to run normally but got %s" % str(ret)))
+		return fail()
+
+	done = true
@@ -0,0 +1,71 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9967
+
+	lua = LuaAPI.new()
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPI.traceback_mode"
+	testDescription = "
+Raises the same error with each traceback_mode and checks which messages carry a stack traceback.
+"
+
+func fail():
+	status = false
+	done = true
+
+func get_error_message(mode: int) -> Variant:
+	lua.traceback_mode = mode
+	var err = lua.call_function("validate", [])
+	if not err is LuaError:
+		return null
+	return err.message
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	lua.bind_libraries(["base"])
+	var err = lua.do_string("
+	function validate()
+		error('invalid value')
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if lua.traceback_mode != LuaAPI.TRACEBACK_FULL:
+		errors.append(LuaError.new_error("traceback_mode does not default to TRACEBACK_FULL"))
+		return fail()
+
+	var full = get_error_message(LuaAPI.TRACEBACK_FULL)
+	var none = get_error_message(LuaAPI.TRACEBACK_NONE)
+	var lazy = get_error_message(LuaAPI.TRACEBACK_LAZY)
+	if full == null or none == null or lazy == null:
+		errors.append(LuaError.new_error("validate did not return a LuaError"))
+		return fail()
+
+	for message in [full, none, lazy]:
+		if not "invalid value" in message:
+			errors.append(LuaError.new_error("Error message is missing the error: '%s'" % message))
+			return fail()
+
+	if not "stack traceback" in full or not "stack traceback" in lazy:
+		errors.append(LuaError.new_error("Full or lazy message is missing the traceback"))
+		return fail()
+
+	if "stack traceback" in none:
+		errors.append(LuaError.new_error("TRACEBACK_NONE message has a traceback: '%s'" % none))
+		return fail()
+
+	if not "validate" in lazy:
+		errors.append(LuaError.new_error("Lazy traceback does not name the function: '%s'" % lazy))
+		return fail()
+
+	done = true
@@ -0,0 +1,40 @@
+extends UnitTest
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9945
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaAPINative.get_interface"
+	testDescription = "
+Checks the LuaAPINative singleton hands out the native interface table for the current version only.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	if not Engine.has_singleton("LuaAPINative"):
+		errors.append(LuaError.new_error("LuaAPINative singleton is not registered", LuaError.ERR_RUNTIME))
+		return fail()
+
+	var native = Engine.get_singleton("LuaAPINative")
+	if native.get_interface(1) == 0:
+		errors.append(LuaError.new_error("get_interface(1) returned 0", LuaError.ERR_RUNTIME))
+		return fail()
+
+	if native.get_interface(1) != native.get_interface():
+		errors.append(LuaError.new_error("get_interface() does not default to the current version", LuaError.ERR_RUNTIME))
+		return fail()
+
+	if native.get_interface(-1) != 0:
+		errors.append(LuaError.new_error("get_interface(-1) did not return 0", LuaError.ERR_RUNTIME))
+		return fail()
+
+	done = true
@@ -0,0 +1,60 @@
+extends UnitTest
+var lua: LuaAPI
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9935
+
+	lua = LuaAPI.new()
+	lua.push_variant("scale", LuaCallableExtra.with_signature(_scale, [TYPE_FLOAT, TYPE_VECTOR2], TYPE_FLOAT))
+	lua.push_variant("bad_return", LuaCallableExtra.with_signature(_bad_return, [], TYPE_INT))
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaCallableExtra.with_signature"
+	testDescription = "
+Exposes functions with a declared signature.
+Valid calls should convert their arguments, wrong argument types and return types should raise errors.
+"
+
+func _scale(factor: float, v: Vector2) -> float:
+	return factor * v.x
+
+func _bad_return():
+	return "not an int"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("result = scale(2, Vector2(3, 4))")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var result = lua.pull_variant("result")
+	if not result == 6:
+		errors.append(LuaError.new_error("result is not 6 but is '%s'" % str(result)))
+		return fail()
+
+	err = lua.do_string("scale(2, 3)")
+	if not err is LuaError:
+		errors.append(LuaError.new_error("passing a number as a Vector2 did not raise an error"))
+		return fail()
+
+	err = lua.do_string("scale(2)")
+	if not err is LuaError:
+		errors.append(LuaError.new_error("passing too few arguments did not raise an error"))
+		return fail()
+
+	err = lua.do_string("bad_return()")
+	if not err is LuaError:
+		errors.append(LuaError.new_error("returning a String for a TYPE_INT signature did not raise an error"))
+		return fail()
+
+	done = true
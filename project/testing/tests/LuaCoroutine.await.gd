@@ -0,0 +1,88 @@
+extends UnitTest
+var lua: LuaAPI
+var co: LuaCoroutine
+
+signal fired(a, b)
+signal other_fired(a)
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9515
+
+	lua = LuaAPI.new()
+	lua.bind_libraries(["base", "coroutine"])
+	co = lua.new_coroutine()
+	co.push_variant("sig", fired)
+
+	co.load_string("
+	local a, b = await(sig)
+	result = a + b
+	")
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaCoroutine.await"
+	testDescription = "
+Suspends a coroutine with await(signal) and resumes it by emitting the signal.
+A coroutine resumed by coroutine.resume while awaiting is not resumed again by the signal.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var ret = co.resume([])
+	if ret is LuaError:
+		errors.append(ret)
+		return fail()
+
+	if not co.is_awaiting() or co.is_done():
+		errors.append(LuaError.new_error("Expected the coroutine to be awaiting the signal"))
+		return fail()
+
+	if not (co.resume([]) is LuaError):
+		errors.append(LuaError.new_error("Resuming an awaiting coroutine did not return a LuaError"))
+		return fail()
+
+	fired.emit(2, 3)
+
+	if co.is_awaiting() or not co.is_done():
+		errors.append(LuaError.new_error("Emitting the signal did not finish the coroutine"))
+		return fail()
+
+	var result = co.pull_variant("result")
+	if result != 5:
+		errors.append(LuaError.new_error("Expected result to be 5 but got %s" % str(result)))
+		return fail()
+
+	lua.push_variant("other_sig", other_fired)
+	var err = lua.do_string("
+	other = coroutine.create(function()
+		local v = await(other_sig)
+		stage = 'first:' .. tostring(v)
+		local w = coroutine.yield()
+		stage = 'second:' .. tostring(w)
+	end)
+	coroutine.resume(other)
+	coroutine.resume(other, 'manual')
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	# The await already returned, so the signal must not resume the plain yield after it
+	other_fired.emit("signal")
+	if lua.pull_variant("stage") != "first:manual":
+		errors.append(LuaError.new_error("Expected the stale await to be ignored but stage is %s" % str(lua.pull_variant("stage"))))
+		return fail()
+
+	if lua.do_string("await(sig)") == null:
+		errors.append(LuaError.new_error("Calling await outside of a coroutine did not return a LuaError"))
+		return fail()
+
+	done = true
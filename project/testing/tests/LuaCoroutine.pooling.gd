@@ -0,0 +1,103 @@
+extends UnitTest
+var lua: LuaAPI
+var taken: Callable
+
+const ITERATIONS = 10000
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9510
+
+	lua = LuaAPI.new()
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaCoroutine.pooling"
+	testDescription = "
+Spawns 10k short coroutines and checks Lua memory returns to where it started.
+Also checks the same Lua thread always gives the same LuaCoroutine.
+A thread Lua kept with coroutine.running() is never handed to another LuaCoroutine.
+A function taken inside a coroutine still works after its thread is pooled and reused.
+"
+
+func _take(fn: Callable):
+	taken = fn
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	lua.bind_libraries(["base", "coroutine"])
+	var err = lua.do_string("co = coroutine.create(function() end)")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var a = lua.pull_variant("co")
+	var b = lua.pull_variant("co")
+	if not (a is LuaCoroutine) or a != b:
+		errors.append(LuaError.new_error("Pulling the same thread twice gave different LuaCoroutines"))
+		return fail()
+
+	# Lua keeps this thread after its wrapper is gone, so it must not be pooled
+	var pooled = lua.get_pooled_thread_count()
+	var kept = lua.new_coroutine()
+	kept.load_string("saved = coroutine.running()")
+	kept.resume([])
+	kept = null
+	if lua.get_pooled_thread_count() != pooled:
+		errors.append(LuaError.new_error("A thread Lua still references was pooled"))
+		return fail()
+
+	var saved = lua.pull_variant("saved")
+	var fresh = lua.new_coroutine()
+	if not (saved is LuaCoroutine) or saved == fresh:
+		errors.append(LuaError.new_error("A thread Lua still references was handed to a new LuaCoroutine"))
+		return fail()
+	saved = null
+	fresh = null
+
+	# The callable must not be bound to the thread, which is pooled and then suspended by another coroutine
+	lua.push_variant("take", _take)
+	var taker = lua.new_coroutine()
+	taker.load_string("take(function(v) return v * 2 end)")
+	taker.resume([])
+	taker = null
+
+	var reused = lua.new_coroutine()
+	reused.load_string("local v = coroutine.yield(7) return v")
+	reused.resume([])
+	if taken.call(21) != 42:
+		errors.append(LuaError.new_error("A function taken inside a pooled coroutine did not return 42"))
+		return fail()
+
+	if reused.resume([3]) != [3]:
+		errors.append(LuaError.new_error("Calling the taken function disturbed the reused coroutine"))
+		return fail()
+	reused = null
+
+	lua.configure_gc(LuaAPI.GC_COLLECT, 0)
+	var baseline = lua.get_memory_usage()
+
+	for i in range(ITERATIONS):
+		var co = lua.new_coroutine()
+		co.load_string("return 1")
+		var ret = co.resume([])
+		if ret is LuaError:
+			errors.append(ret)
+			return fail()
+
+	lua.configure_gc(LuaAPI.GC_COLLECT, 0)
+	var growth = lua.get_memory_usage() - baseline
+
+	# Only the pooled threads may stay alive
+	if growth > 1024 * 1024:
+		errors.append(LuaError.new_error("Lua memory grew by %d bytes after %d coroutines" % [growth, ITERATIONS]))
+		return fail()
+
+	done = true
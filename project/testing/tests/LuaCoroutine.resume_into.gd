@@ -0,0 +1,60 @@
+extends UnitTest
+var lua: LuaAPI
+var co: LuaCoroutine
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9505
+
+	lua = LuaAPI.new()
+	co = lua.new_coroutine()
+
+	co.load_string("
+	local total = 0
+	for i=1,3,1 do
+		total = total + yield(i, i * 2)
+	end
+	return 'done', total
+	")
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaCoroutine.resume_into"
+	testDescription = "
+Resumes a coroutine with resume_into, reusing one results array for every resume.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var results = []
+	var err = co.resume_into([], results)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	for i in range(1, 4):
+		if results != [i, i * 2]:
+			errors.append(LuaError.new_error("Expected %s but got %s" % [str([i, i * 2]), str(results)]))
+			return fail()
+
+		err = co.resume_into([10], results)
+		if err is LuaError:
+			errors.append(err)
+			return fail()
+
+	if not co.is_done() or results != ["done", 30]:
+		errors.append(LuaError.new_error("Expected the coroutine to return done, 30 but got %s" % str(results)))
+		return fail()
+
+	if not (co.resume_into([], results) is LuaError):
+		errors.append(LuaError.new_error("Resuming a finished coroutine did not return a LuaError"))
+		return fail()
+
+	done = true
@@ -0,0 +1,68 @@
+extends UnitTest
+var lua: LuaAPI
+var job: LuaJob
+var finishedWith = null
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9520
+
+	lua = LuaAPI.new()
+	var ret = lua.do_string_job("
+	local total = 0
+	for i=1,10000000,1 do
+		total = total + 1
+	end
+	return total, ...
+	", ["extra"])
+	if ret is LuaError:
+		errors.append(ret)
+		return
+
+	job = ret
+	job.budget_usec = 1000
+	job.finished.connect(_on_finished)
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaJob.step"
+	testDescription = "
+Runs a long loop as a LuaJob, which is preempted once its budget is spent.
+"
+
+func _on_finished(results):
+	finishedWith = results
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	if job == null:
+		return fail()
+
+	while job.step():
+		pass
+
+	if job.get_status() != LuaJob.STATUS_FINISHED:
+		errors.append(job.get_error())
+		return fail()
+
+	if job.get_step_count() < 2:
+		errors.append(LuaError.new_error("Expected the job to be preempted but it ran in %d step" % job.get_step_count()))
+		return fail()
+
+	if finishedWith != [10000000, "extra"] or job.get_results() != finishedWith:
+		errors.append(LuaError.new_error("Unexpected results %s" % str(finishedWith)))
+		return fail()
+
+	var err = lua.call_function_job("does_not_exist")
+	if not (err is LuaError):
+		errors.append(LuaError.new_error("Starting a job for a missing function did not return a LuaError"))
+		return fail()
+
+	done = true
@@ -0,0 +1,132 @@
+extends UnitTest
+var lua: LuaAPI
+var group: LuaProcessGroup
+
+var failed: Array = []
+var spawned: Array = []
+
+const OBJECTS = 100
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9932
+
+	lua = LuaAPI.new()
+	group = LuaProcessGroup.new()
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaProcessGroup.tick"
+	testDescription = "
+Drives 100 Lua objects from one tick, adds and removes entries while ticking and checks errors stay per entry.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _on_failed(entry_id: int, err: LuaError):
+	failed.append(entry_id)
+	# Removing from the signal handler happens while the group is ticking
+	group.remove(entry_id)
+
+func _spawn():
+	spawned.append(group.add("count"))
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	lua.bind_libraries(["base"])
+	lua.push_variant("spawn", _spawn)
+	var err = lua.do_string("
+	objects = {}
+	for i=1,%d do
+		objects['o' .. i] = { x = 0, update = function(self, dt) self.x = self.x + dt end }
+	end
+
+	counted = 0
+	function count(dt) counted = counted + 1 end
+	function bad(dt) error('bad entry') end
+
+	local spawnedOnce = false
+	function spawner(dt)
+		if not spawnedOnce then
+			spawnedOnce = true
+			spawn()
+		end
+	end
+	" % OBJECTS)
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	group.bind(lua)
+	group.entry_failed.connect(_on_failed)
+	group.profiling = true
+
+	for i in range(OBJECTS):
+		var entry = group.add_method("objects.o%d" % (i + 1), "update")
+		if entry is LuaError:
+			errors.append(entry)
+			return fail()
+
+	var bad = group.add("bad")
+	group.add("spawner")
+	var missing = group.add("no_such_function")
+	if not (missing is LuaError):
+		errors.append(LuaError.new_error("Expected a LuaError when adding a missing function"))
+		return fail()
+
+	# Values Lua can not hold are rejected before anything is pushed
+	var rejected = [
+		group.add("count", LuaError.new_error("not a self")),
+		group.add("count", LuaTuple.from_array([1, 2])),
+		group.add("count", Transform3D()),
+		group.add(LuaError.new_error("not a function")),
+	]
+	for entry in rejected:
+		if not (entry is LuaError):
+			errors.append(LuaError.new_error("Expected a LuaError for an unpushable argument but got %s" % str(entry)))
+			return fail()
+
+	if group.get_count() != OBJECTS + 2:
+		errors.append(LuaError.new_error("Expected rejected entries not to be added"))
+		return fail()
+
+	var called = group.tick(0.5)
+
+	if called != OBJECTS + 2:
+		errors.append(LuaError.new_error("Expected %d entries called but got %d" % [OBJECTS + 2, called]))
+		return fail()
+
+	if failed != [bad] or group.has(bad):
+		errors.append(LuaError.new_error("Expected only the bad entry to fail and be removed, got %s" % str(failed)))
+		return fail()
+
+	# The entry added during the tick first runs on the next one
+	if spawned.size() != 1 or lua.pull_variant("counted") != 0:
+		errors.append(LuaError.new_error("Expected the spawned entry to wait for the next tick"))
+		return fail()
+
+	group.tick(0.5)
+	if lua.pull_variant("counted") != 1 or failed.size() != 1:
+		errors.append(LuaError.new_error("Expected the spawned entry to run once and no new failures"))
+		return fail()
+
+	var x = lua.do_string("return objects.o%d.x" % OBJECTS)
+	if x != 1.0:
+		errors.append(LuaError.new_error("Expected the objects to keep their state, got x = %s" % str(x)))
+		return fail()
+
+	if group.get_entry_time_usec(spawned[0]) < 0 or group.get_tick_time_usec() <= 0:
+		errors.append(LuaError.new_error("Expected per entry timings with profiling on"))
+		return fail()
+
+	group.clear()
+	if group.get_count() != 0 or group.tick(0.5) != 0:
+		errors.append(LuaError.new_error("Expected an empty group after clear"))
+		return fail()
+
+	done = true
@@ -0,0 +1,135 @@
+extends UnitTest
+var lua: LuaAPI
+var scheduler: LuaScheduler
+
+var finished: Array = []
+var failed: Array = []
+
+const TASKS = 200
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9930
+
+	lua = LuaAPI.new()
+	scheduler = LuaScheduler.new()
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "LuaScheduler.tick"
+	testDescription = "
+Runs tasks using wait, wait_frames and wait_event, checks priorities and failures.
+Sleeping tasks must stay asleep until they are due, and budget_usec leaves the rest for later ticks.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _on_finished(task_id: int, results: Array):
+	finished.append([task_id, results])
+
+func _on_failed(task_id: int, err: LuaError):
+	failed.append(task_id)
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	lua.bind_libraries(["base", "coroutine", "table"])
+	scheduler.bind(lua)
+	scheduler.task_finished.connect(_on_finished)
+	scheduler.task_failed.connect(_on_failed)
+
+	var err = lua.do_string("
+	order = {}
+	function timed(name)
+		wait(1.0)
+		table.insert(order, name)
+		return name
+	end
+
+	function framed()
+		wait_frames(3)
+		table.insert(order, 'framed')
+	end
+
+	function evented()
+		local a, b = wait_event('door')
+		return a + b
+	end
+
+	function broken()
+		coroutine.yield()
+		error('broken task')
+	end
+
+	function sleeper()
+		while true do
+			wait(100)
+		end
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var low = scheduler.spawn("timed", ["low"], LuaScheduler.PRIORITY_LOW)
+	var high = scheduler.spawn("timed", ["high"], LuaScheduler.PRIORITY_HIGH)
+	scheduler.spawn("framed")
+	var evented = scheduler.spawn("evented")
+	var broken = scheduler.spawn("broken")
+
+	if not (scheduler.spawn("missing") is LuaError):
+		errors.append(LuaError.new_error("Spawning a missing function did not return a LuaError"))
+		return fail()
+
+	# The first tick starts everything, the timed tasks are due a second later
+	scheduler.tick(0.5)
+	scheduler.tick(0.4)
+	scheduler.tick(0.7)
+	if lua.pull_variant("order") != ["high", "low"]:
+		errors.append(LuaError.new_error("Tasks ran in the wrong order: %s" % str(lua.pull_variant("order"))))
+		return fail()
+
+	if failed != [broken]:
+		errors.append(LuaError.new_error("Expected the broken task to fail but got %s" % str(failed)))
+		return fail()
+
+	if scheduler.notify("door", [2, 3]) != 1:
+		errors.append(LuaError.new_error("notify did not wake the waiting task"))
+		return fail()
+	scheduler.tick(0.1)
+
+	if not [evented, [5]] in finished or not [high, ["high"]] in finished or not [low, ["low"]] in finished:
+		errors.append(LuaError.new_error("Missing finished tasks: %s" % str(finished)))
+		return fail()
+
+	if scheduler.get_task_count() != 0:
+		errors.append(LuaError.new_error("Expected no tasks left but got %d" % scheduler.get_task_count()))
+		return fail()
+
+	# Sleeping tasks are not resumed before they are due
+	for i in range(TASKS):
+		scheduler.spawn("sleeper")
+	scheduler.tick(0)
+
+	for i in range(10):
+		scheduler.tick(0.016)
+		if scheduler.get_runnable_count() != 0:
+			errors.append(LuaError.new_error("Expected no runnable tasks while all of them sleep"))
+			return fail()
+
+	if scheduler.get_task_count() != TASKS:
+		errors.append(LuaError.new_error("Expected %d tasks but got %d" % [TASKS, scheduler.get_task_count()]))
+		return fail()
+
+	# The budget leaves the rest for later ticks
+	scheduler.budget_usec = 1
+	scheduler.tick(200)
+	if scheduler.get_runnable_count() == 0:
+		errors.append(LuaError.new_error("budget_usec did not leave any tasks for the next tick"))
+		return fail()
+
+	done = true
@@ -0,0 +1,99 @@
+extends UnitTest
+var lua: LuaAPI
+var root: Node
+var body: Node
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9770
+
+	lua = LuaAPI.new()
+	root = Node.new()
+	body = Node.new()
+	body.name = "Body"
+	var sprite = Node.new()
+	sprite.name = "Sprite"
+	root.add_child(body)
+	body.add_child(sprite)
+	lua.push_variant("root", root)
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.node_get_node"
+	testDescription = "
+Calls get_node from lua with string paths.
+Both node.get_node(path) and node:get_node(path) should resolve the node.
+Missing paths should return nil.
+Cached results inside a tree are dropped once the tree changes.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("
+	for i = 1, 10 do
+		a = root:get_node('Body/Sprite')
+		b = root.get_node('Body/Sprite')
+	end
+	missing = root:get_node('Body/Nothing')
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var sprite = body.get_node("Sprite")
+	if not lua.pull_variant("a") == sprite or not lua.pull_variant("b") == sprite:
+		errors.append(LuaError.new_error("get_node did not return Body/Sprite"))
+		return fail()
+
+	if not lua.pull_variant("missing") == null:
+		errors.append(LuaError.new_error("get_node on a missing path did not return nil"))
+		return fail()
+
+	sprite.name = "Renamed"
+	err = lua.do_string("c = root:get_node('Body/Sprite')")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if not lua.pull_variant("c") == null:
+		errors.append(LuaError.new_error("get_node returned a node that was renamed"))
+		return fail()
+
+	# Inside a tree results are cached, a rename changes the tree and must drop them
+	var treeRoot = Node.new()
+	var child = Node.new()
+	child.name = "Child"
+	treeRoot.add_child(child)
+	add_child(treeRoot)
+	lua.push_variant("tree_root", treeRoot)
+	err = lua.do_string("d = tree_root:get_node('Child') d = tree_root:get_node('Child')")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if not lua.pull_variant("d") == child:
+		errors.append(LuaError.new_error("get_node did not return Child inside the tree"))
+		return fail()
+
+	child.name = "Moved"
+	err = lua.do_string("e = tree_root:get_node('Child')")
+	treeRoot.free()
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if not lua.pull_variant("e") == null:
+		errors.append(LuaError.new_error("get_node returned a cached node after the tree changed"))
+		return fail()
+
+	done = true
+
+func _finalize():
+	root.free()
@@ -0,0 +1,65 @@
+extends UnitTest
+var lua: LuaAPI
+var root: Node
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9760
+
+	lua = LuaAPI.new()
+	root = Node.new()
+	add_child(root)
+	for i in range(3):
+		var child = Node.new()
+		child.name = "Child%d" % i
+		root.add_child(child)
+		if i != 1:
+			child.add_to_group("lua_iterator_test")
+	lua.push_variant("root", root)
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.node_iterators"
+	testDescription = "
+Iterates children() and nodes_in_group() with a generic for loop.
+Every child should be visited in order, and only grouped nodes by nodes_in_group().
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("
+	names = ''
+	for child in children(root) do
+		names = names .. child.name
+	end
+
+	grouped = 0
+	for node in nodes_in_group(root, 'lua_iterator_test') do
+		grouped = grouped + 1
+	end
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	var names = lua.pull_variant("names")
+	if not names == "Child0Child1Child2":
+		errors.append(LuaError.new_error("names is not 'Child0Child1Child2' but is '%s'" % str(names)))
+		return fail()
+
+	var grouped = lua.pull_variant("grouped")
+	if not grouped == 2:
+		errors.append(LuaError.new_error("grouped is not 2 but is '%s'" % str(grouped)))
+		return fail()
+
+	done = true
+
+func _finalize():
+	root.free()
@@ -0,0 +1,74 @@
+extends UnitTest
+var lua: LuaAPI
+var node: Node2D
+var restricted: Restricted
+
+class Restricted:
+	var open: int = 1
+	var secret: int = 2
+
+	func lua_fields():
+		return ["secret"]
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9790
+
+	lua = LuaAPI.new()
+	node = Node2D.new()
+	restricted = Restricted.new()
+	lua.push_variant("node", node)
+	lua.push_variant("restricted", restricted)
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "General.property_accessor"
+	testDescription = "
+Creates prop() accessors from lua.
+Setting and getting position through the accessor should reach the node.
+Fields hidden by lua_fields should not be accessible through prop().
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	var err = lua.do_string("
+	local pos = prop(node, 'position')
+	pos:set(Vector2(3, 4))
+	x = pos:get().x
+
+	local open = prop(restricted, 'open')
+	open:set(open:get() + 10)
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if not node.position == Vector2(3, 4):
+		errors.append(LuaError.new_error("node.position is not (3, 4) but is '%s'" % str(node.position)))
+		return fail()
+
+	var x = lua.pull_variant("x")
+	if not x == 3:
+		errors.append(LuaError.new_error("x is not 3 but is '%s'" % str(x)))
+		return fail()
+
+	if not restricted.open == 11:
+		errors.append(LuaError.new_error("restricted.open is not 11 but is '%d'" % restricted.open))
+		return fail()
+
+	err = lua.do_string("prop(restricted, 'secret')")
+	if not err is LuaError:
+		errors.append(LuaError.new_error("prop() on a field hidden by lua_fields did not return an error"))
+		return fail()
+
+	done = true
+
+func _finalize():
+	node.free()
@@ -0,0 +1,79 @@
+extends UnitTest
+var lua: LuaAPI
+
+signal pinged(value)
+
+func _ready():
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._ready()
+	# id will determine the load order
+	id = 9755
+
+	lua = LuaAPI.new()
+
+	# testName and testDescription are for any needed context about the test.
+	testName = "general.signal_bridge"
+	testDescription = "
+Connects, emits and disconnects a signal from Lua with the native connect/emit/disconnect methods.
+Also checks connection handles and that connecting the same function twice returns ERR_INVALID_PARAMETER like Signal.connect.
+"
+
+func fail():
+	status = false
+	done = true
+
+func _process(delta):
+	# Since we are using poly here, we need to make sure to call super for _methods
+	super._process(delta)
+
+	lua.bind_libraries(["base"])
+	lua.push_variant("pinged", pinged)
+
+	var err = lua.do_string("
+	count = 0
+	function on_ping(v)
+		count = count + v
+	end
+
+	conn = pinged:connect(on_ping)
+	pinged:emit(2)
+	pinged.emit(3)
+	duplicate = pinged:connect(on_ping)
+	was_connected = pinged:is_connected(on_ping) and conn:is_connected()
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if pinged.get_connections().size() != 1:
+		errors.append(LuaError.new_error("Expected 1 connection but got %d" % pinged.get_connections().size()))
+		return fail()
+
+	pinged.emit(10)
+
+	err = lua.do_string("
+	disconnected = conn:disconnect()
+	pinged:emit(100)
+	still_connected = pinged:is_connected(on_ping)
+	")
+	if err is LuaError:
+		errors.append(err)
+		return fail()
+
+	if lua.pull_variant("count") != 15:
+		errors.append(LuaError.new_error("count is not 15 but is '%s'" % str(lua.pull_variant("count"))))
+		return fail()
+
+	if lua.pull_variant("duplicate") != ERR_INVALID_PARAMETER:
+		errors.append(LuaError.new_error("Connecting the same function twice returned '%s'" % str(lua.pull_variant("duplicate"))))
+		return fail()
+
+	if lua.pull_variant("was_connected") != true or lua.pull_variant("disconnected") != true:
+		errors.append(LuaError.new_error("Connection handle did not report the connection"))
+		return fail()
+
+	if lua.pull_variant("still_connected") != false or pinged.get_connections().size() != 0:
+		errors.append(LuaError.new_error("Function is still connected after disconnect"))
+		return fail()
+
+	done = true
@@ -1,16 +1,28 @@
 #include "register_types.h"
 #include "src/classes/luaAPI.h"
+#include "src/classes/luaAPINative.h"
 #include "src/classes/luaCallableExtra.h"
 #include "src/classes/luaCoroutine.h"
 #include "src/classes/luaError.h"
 #include "src/classes/luaFunctionRef.h"
+#include "src/classes/luaJob.h"
 #include "src/classes/luaObjectMetatable.h"
+#include "src/classes/luaProcessGroup.h"
+#include "src/classes/luaScheduler.h"
 #include "src/classes/luaTuple.h"
 
+#ifndef LAPI_GDEXTENSION
+#include "core/config/engine.h"
+#else
+#include <godot_cpp/classes/engine.hpp>
+#endif
+
 #ifdef LAPI_GDEXTENSION
 using namespace godot;
 #endif
 
+static LuaAPINative *luaAPINative = nullptr;
+
 void initialize_luaAPI_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
@@ -21,15 +33,36 @@ void initialize_luaAPI_module(ModuleInitializationLevel p_level) {
 	ClassDB::register_class<LuaCoroutine>();
 	ClassDB::register_class<LuaError>();
 	ClassDB::register_class<LuaFunctionRef>();
+	ClassDB::register_class<LuaJob>();
 	ClassDB::register_class<LuaObjectMetatable>();
 	ClassDB::register_class<LuaDefaultObjectMetatable>();
+	ClassDB::register_class<LuaProcessGroup>();
+	ClassDB::register_class<LuaScheduler>();
 	ClassDB::register_class<LuaTuple>();
+	ClassDB::register_class<LuaAPINative>();
+
+	luaAPINative = memnew(LuaAPINative);
+#ifndef LAPI_GDEXTENSION
+	Engine::get_singleton()->add_singleton(Engine::Singleton("LuaAPINative", luaAPINative));
+#else
+	Engine::get_singleton()->register_singleton("LuaAPINative", luaAPINative);
+#endif
 }
 
 void uninitialize_luaAPI_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
 	}
+
+	if (luaAPINative != nullptr) {
+#ifndef LAPI_GDEXTENSION
+		Engine::get_singleton()->remove_singleton("LuaAPINative");
+#else
+		Engine::get_singleton()->unregister_singleton("LuaAPINative");
+#endif
+		memdelete(luaAPINative);
+		luaAPINative = nullptr;
+	}
 }
 
 #ifdef LAPI_GDEXTENSION
@@ -1,12 +1,21 @@
 #include "luaAPI.h"
 
 #include "luaCoroutine.h"
+#include "luaFunctionRef.h"
+#include "luaJob.h"
 #include "luaObjectMetatable.h"
 
 #include <luaState.h>
+#include <util.h>
 
-#ifdef LAPI_GDEXTENSION
+#ifndef LAPI_GDEXTENSION
+#include "scene/main/node.h"
+#include "scene/main/scene_tree.h"
+#else
 #include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/classes/scene_tree.hpp>
+#include <godot_cpp/variant/callable_method_pointer.hpp>
 #endif
 
 LuaAPI::LuaAPI() {
@@ -17,30 +26,61 @@ LuaAPI::LuaAPI() {
 
 	// Creating lua state instance
 	state.setState(lState, this, true);
+
+#ifdef LAPI_GDEXTENSION
+	interruptMutex.instantiate();
+#endif
 }
 
 LuaAPI::~LuaAPI() {
+	// Handles released while closing have nothing left to unref
+	closing = true;
 	lua_close(lState);
+
+	// The api ref is already gone at this point, so run what is left the same way lua_close does.
+	for (uint32_t i = finalizerHead; i < finalizerQueue.size(); i++) {
+		runFinalizer(nullptr, finalizerQueue[i]);
+	}
+	finalizerQueue.clear();
 }
 
 // Bind C++ functions to GDScript
 void LuaAPI::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("do_file", "FilePath", "Args"), &LuaAPI::doFile, DEFVAL(Array()));
 	ClassDB::bind_method(D_METHOD("do_string", "Code", "Args"), &LuaAPI::doString, DEFVAL(Array()));
+	ClassDB::bind_method(D_METHOD("do_string_job", "Code", "Args"), &LuaAPI::doStringJob, DEFVAL(Array()));
+	ClassDB::bind_method(D_METHOD("call_function_job", "LuaFunctionName", "Args"), &LuaAPI::callFunctionJob, DEFVAL(Array()));
 
 	ClassDB::bind_method(D_METHOD("bind_libraries", "Array"), &LuaAPI::bindLibraries);
 	ClassDB::bind_method(D_METHOD("set_hook", "Hook", "HookMask", "Count"), &LuaAPI::setHook);
+	ClassDB::bind_method(D_METHOD("set_hook_filter", "Breakpoints", "Functions"), &LuaAPI::setHookFilter, DEFVAL(PackedStringArray()));
+	ClassDB::bind_method(D_METHOD("set_execution_limit", "instructions", "usec"), &LuaAPI::setExecutionLimit);
+	ClassDB::bind_method(D_METHOD("get_instruction_limit"), &LuaAPI::getInstructionLimit);
+	ClassDB::bind_method(D_METHOD("get_time_limit_usec"), &LuaAPI::getTimeLimitUsec);
+	ClassDB::bind_method(D_METHOD("set_execution_limit_yields", "value"), &LuaAPI::setExecutionLimitYields);
+	ClassDB::bind_method(D_METHOD("get_execution_limit_yields"), &LuaAPI::getExecutionLimitYields);
+	ClassDB::bind_method(D_METHOD("request_interrupt"), &LuaAPI::requestInterrupt);
+
+	ClassDB::bind_method(D_METHOD("post_event", "Event"), &LuaAPI::postEvent);
+	ClassDB::bind_method(D_METHOD("drain_events", "Handler", "Max"), &LuaAPI::drainEvents, DEFVAL(-1));
+	ClassDB::bind_method(D_METHOD("get_pending_event_count"), &LuaAPI::getPendingEventCount);
 	ClassDB::bind_method(D_METHOD("configure_gc", "What", "Data"), &LuaAPI::configureGC);
 	ClassDB::bind_method(D_METHOD("get_memory_usage"), &LuaAPI::getMemoryUsage);
 	ClassDB::bind_method(D_METHOD("push_variant", "Name", "var"), &LuaAPI::pushGlobalVariant);
 	ClassDB::bind_method(D_METHOD("pull_variant", "Name"), &LuaAPI::pullVariant);
+	ClassDB::bind_method(D_METHOD("push_variants", "Vars"), &LuaAPI::pushGlobalVariants);
+	ClassDB::bind_method(D_METHOD("pull_variants", "Names"), &LuaAPI::pullVariants);
 	ClassDB::bind_method(D_METHOD("get_registry_value", "Name"), &LuaAPI::getRegistryValue);
 	ClassDB::bind_method(D_METHOD("set_registry_value", "Name", "var"), &LuaAPI::setRegistryValue);
 	ClassDB::bind_method(D_METHOD("call_function", "LuaFunctionName", "Args"), &LuaAPI::callFunction);
+	ClassDB::bind_method(D_METHOD("get_function_handle", "LuaFunctionName"), &LuaAPI::getFunctionHandle);
+	ClassDB::bind_method(D_METHOD("call_function_batch", "LuaFunctionName", "Args", "Results"), &LuaAPI::callFunctionBatch);
+	ClassDB::bind_method(D_METHOD("call_function_into", "LuaFunctionName", "Args", "Results"), &LuaAPI::callFunctionInto);
 	ClassDB::bind_method(D_METHOD("function_exists", "LuaFunctionName"), &LuaAPI::luaFunctionExists);
 
 	ClassDB::bind_method(D_METHOD("new_coroutine"), &LuaAPI::newCoroutine);
 	ClassDB::bind_method(D_METHOD("get_running_coroutine"), &LuaAPI::getRunningCoroutine);
+	ClassDB::bind_method(D_METHOD("get_pooled_thread_count"), &LuaAPI::getPooledThreadCount);
 
 	ClassDB::bind_method(D_METHOD("set_use_callables", "value"), &LuaAPI::setUseCallables);
 	ClassDB::bind_method(D_METHOD("get_use_callables"), &LuaAPI::getUseCallables);
@@ -51,9 +91,41 @@ void LuaAPI::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_memory_limit", "limit"), &LuaAPI::setMemoryLimit);
 	ClassDB::bind_method(D_METHOD("get_memory_limit"), &LuaAPI::getMemoryLimit);
 
+	ClassDB::bind_method(D_METHOD("set_deferred_finalization", "value"), &LuaAPI::setDeferredFinalization);
+	ClassDB::bind_method(D_METHOD("get_deferred_finalization"), &LuaAPI::getDeferredFinalization);
+
+	ClassDB::bind_method(D_METHOD("set_finalizer_budget_count", "value"), &LuaAPI::setFinalizerBudgetCount);
+	ClassDB::bind_method(D_METHOD("get_finalizer_budget_count"), &LuaAPI::getFinalizerBudgetCount);
+
+	ClassDB::bind_method(D_METHOD("set_finalizer_budget_usec", "value"), &LuaAPI::setFinalizerBudgetUsec);
+	ClassDB::bind_method(D_METHOD("get_finalizer_budget_usec"), &LuaAPI::getFinalizerBudgetUsec);
+
+	ClassDB::bind_method(D_METHOD("drain_finalizers"), &LuaAPI::drainFinalizers);
+	ClassDB::bind_method(D_METHOD("get_pending_finalizer_count"), &LuaAPI::getPendingFinalizerCount);
+	ClassDB::bind_method(D_METHOD("get_peak_finalizer_count"), &LuaAPI::getPeakFinalizerCount);
+
+	ClassDB::bind_method(D_METHOD("set_traceback_mode", "mode"), &LuaAPI::setTracebackMode);
+	ClassDB::bind_method(D_METHOD("get_traceback_mode"), &LuaAPI::getTracebackMode);
+
+	ClassDB::bind_method(D_METHOD("set_report_external_memory", "value"), &LuaAPI::setReportExternalMemory);
+	ClassDB::bind_method(D_METHOD("get_report_external_memory"), &LuaAPI::getReportExternalMemory);
+	ClassDB::bind_method(D_METHOD("get_external_memory_usage"), &LuaAPI::getExternalMemoryUsage);
+
+	{
+		MethodInfo mi;
+		mi.name = "return_values";
+		ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "return_values", &LuaAPI::returnValues, mi);
+	}
+
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "use_callables"), "set_use_callables", "get_use_callables");
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "object_metatable"), "set_object_metatable", "get_object_metatable");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "memory_limit"), "set_memory_limit", "get_memory_limit");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "deferred_finalization"), "set_deferred_finalization", "get_deferred_finalization");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "finalizer_budget_count"), "set_finalizer_budget_count", "get_finalizer_budget_count");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "finalizer_budget_usec"), "set_finalizer_budget_usec", "get_finalizer_budget_usec");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "traceback_mode", PROPERTY_HINT_ENUM, "Full,None,Lazy"), "set_traceback_mode", "get_traceback_mode");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "report_external_memory"), "set_report_external_memory", "get_report_external_memory");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "execution_limit_yields"), "set_execution_limit_yields", "get_execution_limit_yields");
 
 	BIND_ENUM_CONSTANT(HOOK_MASK_CALL);
 	BIND_ENUM_CONSTANT(HOOK_MASK_RETURN);
@@ -68,6 +140,10 @@ void LuaAPI::_bind_methods() {
 	BIND_ENUM_CONSTANT(GC_STEP);
 	BIND_ENUM_CONSTANT(GC_SETPAUSE);
 	BIND_ENUM_CONSTANT(GC_SETSTEPMUL);
+
+	BIND_ENUM_CONSTANT(TRACEBACK_FULL);
+	BIND_ENUM_CONSTANT(TRACEBACK_NONE);
+	BIND_ENUM_CONSTANT(TRACEBACK_LAZY);
 }
 
 // Calls LuaState::bindLibs()
@@ -79,6 +155,480 @@ void LuaAPI::setHook(Callable hook, int mask, int count) {
 	return state.setHook(hook, mask, count);
 }
 
+// Calls LuaState::setHookFilter()
+void LuaAPI::setHookFilter(Dictionary breakpoints, PackedStringArray functions) {
+	return state.setHookFilter(breakpoints, functions);
+}
+
+// A null hook removes the thread's own hook. Other threads then go back to using the main state's hook, but get none if set to null explicitly.
+// Replacing a hook keeps its filter.
+void LuaAPI::setThreadHook(lua_State *thread, Callable hook, int mask, int count) {
+	if (hook.is_null() && thread == lState) {
+		threadHooks.erase(thread);
+	} else {
+		ThreadHook entry;
+		if (hook.is_valid()) {
+			entry.hook = hook;
+			entry.mask = mask;
+			entry.count = count;
+			if (const ThreadHook *existing = threadHooks.getptr(thread); existing != nullptr) {
+				entry.filter = existing->filter;
+			}
+		}
+		threadHooks.insert(thread, entry);
+	}
+	refreshHook(thread);
+}
+
+// breakpoints maps chunk names to the lines that reach the hook, functions lists the function names whose calls and returns reach it.
+// A chunk name matches every chunk whose name ends with it, so "mod.lua" matches the absolute path do_file loads it with.
+void LuaAPI::setThreadHookFilter(lua_State *thread, Dictionary breakpoints, PackedStringArray functions) {
+	ThreadHook *entry = threadHooks.getptr(thread);
+	ERR_FAIL_COND_MSG(entry == nullptr || entry->hook.is_null(), "Set a hook with set_hook before filtering it.");
+
+	HookFilter filter;
+	Array sources = breakpoints.keys();
+	for (int i = 0; i < sources.size(); i++) {
+		CharString source = String(sources[i]).utf8();
+		Array lines = breakpoints[sources[i]];
+		for (int j = 0; j < lines.size(); j++) {
+			int line = lines[j];
+			if (LocalVector<CharString> *names = filter.lines.getptr(line); names != nullptr) {
+				names->push_back(source);
+			} else {
+				LocalVector<CharString> newNames;
+				newNames.push_back(source);
+				filter.lines.insert(line, newNames);
+			}
+		}
+	}
+
+	for (int i = 0; i < functions.size(); i++) {
+		filter.functions.push_back(functions[i].utf8());
+	}
+	entry->filter = filter;
+}
+
+// Most line events are rejected by the line lookup alone, the chunk name is only fetched for lines with a breakpoint
+bool LuaAPI::HookFilter::allowsLine(lua_State *state, lua_Debug *ar) const {
+	if (lines.is_empty()) {
+		return true;
+	}
+
+	const LocalVector<CharString> *names = lines.getptr(ar->currentline);
+	if (names == nullptr) {
+		return false;
+	}
+
+	lua_getinfo(state, "S", ar);
+	size_t length = strlen(ar->source);
+	for (const CharString &name : *names) {
+		size_t nameLength = name.length();
+		if (nameLength <= length && strcmp(ar->source + length - nameLength, name.get_data()) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool LuaAPI::HookFilter::allowsFunction(lua_State *state, lua_Debug *ar) const {
+	if (functions.is_empty()) {
+		return true;
+	}
+
+	lua_getinfo(state, "n", ar);
+	if (ar->name == nullptr) {
+		return false;
+	}
+
+	for (const CharString &name : functions) {
+		if (strcmp(ar->name, name.get_data()) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Installs LuaState::luaHook with the events the thread's hook wants, plus count events while an execution limit or a LuaJob needs them
+void LuaAPI::refreshHook(lua_State *thread) {
+	const ThreadHook *entry = threadHooks.getptr(thread);
+	if (entry == nullptr) {
+		entry = threadHooks.getptr(lState);
+	}
+
+	int mask = 0;
+	int count = 0;
+	if (entry != nullptr) {
+		mask = entry->mask;
+		count = entry->count;
+	}
+
+	if (instructionLimit > 0 || timeLimitUsec > 0 || (runningJob != nullptr && runningJob->getThread() == thread)) {
+		int check = CHECK_INSTRUCTIONS;
+		if (instructionLimit > 0 && instructionLimit < check) {
+			check = (int)instructionLimit;
+		}
+		count = (mask & LUA_MASKCOUNT) ? MIN(count, check) : check;
+		mask |= LUA_MASKCOUNT;
+	}
+
+	if (mask == 0) {
+		lua_sethook(thread, nullptr, 0, 0);
+		return;
+	}
+	lua_sethook(thread, LuaState::luaHook, mask, MAX(count, 1));
+}
+
+// Either limit can be 0 for none. Applies to calls into Lua made after this, and to threads they create.
+void LuaAPI::setExecutionLimit(int64_t instructions, int64_t usec) {
+	instructionLimit = MAX(instructions, (int64_t)0);
+	timeLimitUsec = MAX(usec, (int64_t)0);
+	refreshHook(lState);
+}
+
+int64_t LuaAPI::getInstructionLimit() const {
+	return instructionLimit;
+}
+
+int64_t LuaAPI::getTimeLimitUsec() const {
+	return timeLimitUsec;
+}
+
+void LuaAPI::setExecutionLimitYields(bool value) {
+	executionLimitYields = value;
+}
+
+bool LuaAPI::getExecutionLimitYields() const {
+	return executionLimitYields;
+}
+
+// Makes thread the one request_interrupt hooks and returns the one before it. Only called by the thread running the state.
+// The pointer is swapped with a single atomic add, which also reports whether request_interrupt was busy with the old thread.
+lua_State *LuaAPI::publishEnteredThread(lua_State *thread) {
+	uintptr_t current = enteredThread.get() & ~(uintptr_t)1;
+	uintptr_t old = enteredThread.postadd((uintptr_t)thread - current);
+	if (old & 1) {
+		// Waits for request_interrupt to be done with the old thread before it can be released
+#ifndef LAPI_GDEXTENSION
+		MutexLock lock(interruptMutex);
+#else
+		MutexLock lock(*interruptMutex.ptr());
+#endif
+	}
+	return (lua_State *)current;
+}
+
+lua_State *LuaAPI::beginExecution(lua_State *state) {
+	lua_State *previous = publishEnteredThread(state);
+	// A pending interrupt moves along to the thread that is now running
+	if (interruptRequested.is_set()) {
+		setInterruptHook(state);
+	}
+
+	if (execution.depth++ > 0) {
+		return previous;
+	}
+
+	execution.thread = state;
+	execution.instructions = 0;
+	execution.exceeded = false;
+	execution.yielded = false;
+	execution.interrupted = false;
+	if (instructionLimit == 0 && timeLimitUsec == 0) {
+		return previous;
+	}
+
+	if (timeLimitUsec > 0) {
+		execution.start = get_ticks_usec();
+	}
+
+	// Threads created before the limit was set do not have the hook yet
+	if (lua_gethook(state) != LuaState::luaHook || !(lua_gethookmask(state) & LUA_MASKCOUNT)) {
+		refreshHook(state);
+	}
+	return previous;
+}
+
+void LuaAPI::endExecution(lua_State *previous) {
+	bool outermost = --execution.depth == 0;
+	lua_State *ended = publishEnteredThread(previous);
+	bool pending = interruptRequested.is_set();
+	if (pending && previous != nullptr) {
+		setInterruptHook(previous);
+	}
+	// Only the call running when it was requested is interrupted
+	if (outermost) {
+		interruptRequested.clear();
+	}
+
+	// Back to the usual hook once the interrupt hook or the per instruction checks are no longer needed.
+	// The outermost thread keeps checking every instruction until the outermost call returns.
+	bool sped = execution.exceeded && (outermost || ended != execution.thread);
+	if (ended != nullptr && (pending || sped)) {
+		refreshHook(ended);
+	}
+	if (outermost) {
+		execution.thread = nullptr;
+	}
+}
+
+// Asks the running call to stop at its next safe point, and can be called from any thread.
+// Nothing is hooked until then, so there is no cost while no interrupt is pending. Ignored if no call is running.
+void LuaAPI::requestInterrupt() {
+#ifndef LAPI_GDEXTENSION
+	MutexLock lock(interruptMutex);
+#else
+	MutexLock lock(*interruptMutex.ptr());
+#endif
+	// Requests are serialized by the mutex, so the busy bit is clear here and adding 1 sets it
+	lua_State *thread = (lua_State *)enteredThread.postadd(1);
+	if (thread != nullptr) {
+		interruptRequested.set();
+		setInterruptHook(thread);
+	}
+	enteredThread.sub(1);
+}
+
+// Queues an event for drain_events. Safe to call from any thread, it never touches the Lua state.
+void LuaAPI::postEvent(Variant event) {
+	events.push(event);
+}
+
+// Must be called on the thread that owns the state. Calls the handler once as handler(events, count) with a Lua array of up to
+// max queued events, every event if max is 0 or less, in the order they were posted. Unsupported events are nil in the array. Returns the number of events delivered or a LuaError.
+// The handler is a global function name, a LuaCallable or a LuaFunctionRef. Events are dequeued even if the handler fails.
+Variant LuaAPI::drainEvents(Variant handler, int max) {
+	int top = lua_gettop(lState);
+	lua_rawgeti(lState, LUA_REGISTRYINDEX, state.getErrorHandlerRef());
+	if (handler.get_type() == Variant::STRING || handler.get_type() == Variant::STRING_NAME) {
+		if (!pushGlobalFunction(handler)) {
+			lua_settop(lState, top);
+			return LuaError::newError(vformat("Function \"%s\" does not exist.", handler), LuaError::ERR_RUNTIME);
+		}
+	} else {
+		LuaState::pushVariant(lState, handler);
+		if (lua_type(lState, -1) != LUA_TFUNCTION) {
+			lua_settop(lState, top);
+			return LuaError::newError("Handler is not a Lua function.", LuaError::ERR_TYPE);
+		}
+	}
+
+	int64_t pending = events.getSize();
+	if (max > 0 && pending > max) {
+		pending = max;
+	}
+	lua_createtable(lState, (int)CLAMP(pending, (int64_t)0, (int64_t)INT32_MAX), 0);
+
+	int count = 0;
+	Variant event;
+	while ((max <= 0 || count < max) && events.pop(event)) {
+		// No protected call is running here, so values pushVariant would fail on or raise are screened out first
+		if (LuaState::checkPushable(event).is_valid()) {
+			lua_pushnil(lState);
+		} else {
+			LuaState::pushVariant(lState, event);
+		}
+		lua_rawseti(lState, -2, ++count);
+	}
+
+	if (count == 0) {
+		lua_settop(lState, top);
+		return 0;
+	}
+
+	Ref<LuaError> err;
+	{
+		ExecutionScope scope(this, lState);
+		lua_pushinteger(lState, count);
+		int ret = lua_pcall(lState, 2, 0, top + 1);
+		if (ret != LUA_OK) {
+			err = LuaState::handleError(lState, ret);
+		}
+	}
+	lua_settop(lState, top);
+
+	if (err.is_valid()) {
+		return err;
+	}
+	return count;
+}
+
+// Only a hint while other threads are posting
+int64_t LuaAPI::getPendingEventCount() const {
+	return events.getSize();
+}
+
+// lua_sethook is the one function Lua allows to be called while the thread runs, the same way lua.c stops scripts on a signal.
+// Call and return events stop code that spends its time in C functions.
+void LuaAPI::setInterruptHook(lua_State *thread) {
+	lua_sethook(thread, LuaState::luaHook, LUA_MASKCALL | LUA_MASKRET | LUA_MASKCOUNT, 1);
+}
+
+// True if the error being handled was raised by the execution limit
+bool LuaAPI::executionLimitHit() const {
+	return execution.depth > 0 && execution.exceeded && !execution.yielded;
+}
+
+// True if the thread entered by the outermost call yielded because of the execution limit
+bool LuaAPI::executionLimitYielded() const {
+	return execution.depth > 0 && execution.yielded;
+}
+
+// True if the limit was hit because of request_interrupt
+bool LuaAPI::executionInterrupted() const {
+	return execution.depth > 0 && execution.interrupted;
+}
+
+// Called from hooks while an interrupt is pending. Hooks can only yield on count events, the interrupt hook gets one on the next instruction.
+LuaAPI::LimitAction LuaAPI::checkInterrupt(lua_State *state, bool canYield) {
+	if (execution.depth == 0 || !interruptRequested.is_set()) {
+		return LIMIT_NONE;
+	}
+
+	bool yields = executionLimitYields && state == execution.thread && state != lState && lua_isyieldable(state);
+	if (yields && !canYield) {
+		return LIMIT_NONE;
+	}
+
+	interruptRequested.clear();
+	execution.exceeded = true;
+	execution.interrupted = true;
+	if (yields) {
+		execution.yielded = true;
+		return LIMIT_YIELD;
+	}
+
+	lua_sethook(execution.thread, LuaState::luaHook, lua_gethookmask(execution.thread) | LUA_MASKCOUNT, 1);
+	return LIMIT_RAISE;
+}
+
+// Called from count hooks with the number of instructions since the last one. Once exceeded, every check fails until the outermost call returns,
+// so a script can not keep going by catching the error with pcall.
+LuaAPI::LimitAction LuaAPI::checkExecutionLimit(lua_State *state, int count) {
+	if (interruptRequested.is_set()) {
+		return checkInterrupt(state, true);
+	}
+
+	if (execution.depth == 0) {
+		return LIMIT_NONE;
+	}
+
+	// Also when only an interrupt set it, so a pcall loop can not swallow the interrupt
+	if (execution.exceeded) {
+		return LIMIT_RAISE;
+	}
+
+	if (instructionLimit == 0 && timeLimitUsec == 0) {
+		return LIMIT_NONE;
+	}
+
+	execution.instructions += count;
+
+	if (instructionLimit > 0 && execution.instructions >= instructionLimit) {
+		execution.exceeded = true;
+	} else if (timeLimitUsec > 0 && get_ticks_usec() - execution.start >= (uint64_t)timeLimitUsec) {
+		execution.exceeded = true;
+	} else {
+		return LIMIT_NONE;
+	}
+
+	if (executionLimitYields && state == execution.thread && state != lState && lua_isyieldable(state)) {
+		execution.yielded = true;
+		return LIMIT_YIELD;
+	}
+
+	// Checked on every instruction from now on. Otherwise a loop around pcall could have every check land inside the pcall.
+	lua_sethook(execution.thread, LuaState::luaHook, lua_gethookmask(execution.thread) | LUA_MASKCOUNT, 1);
+	return LIMIT_RAISE;
+}
+
+// Calls the GDScript hook of the thread for the event, if it asked for it. Returns false with the error message pushed if the hook failed.
+bool LuaAPI::dispatchHook(lua_State *state, lua_Debug *ar) {
+	ThreadHook *entry = threadHooks.getptr(state);
+	if (entry == nullptr) {
+		entry = threadHooks.getptr(lState);
+	}
+	if (entry == nullptr || entry->hook.is_null()) {
+		return true;
+	}
+
+#ifndef LAPI_LUAJIT
+	int eventMask = ar->event == LUA_HOOKTAILCALL ? LUA_MASKCALL : (1 << ar->event);
+#else
+	int eventMask = ar->event == LUA_HOOKTAILRET ? LUA_MASKRET : (1 << ar->event);
+#endif
+	if (!(entry->mask & eventMask)) {
+		return true;
+	}
+
+	if (eventMask == LUA_MASKLINE && !entry->filter.allowsLine(state, ar)) {
+		return true;
+	}
+
+	if ((eventMask == LUA_MASKCALL || eventMask == LUA_MASKRET) && !entry->filter.allowsFunction(state, ar)) {
+		return true;
+	}
+
+	// The count event may come more often than this hook asked for, when a limit needs it more often
+	if (ar->event == LUA_HOOKCOUNT) {
+		entry->counted += lua_gethookcount(state);
+		if (entry->counted < entry->count) {
+			return true;
+		}
+		entry->counted = 0;
+	}
+
+	// The hook may replace itself
+	Callable hook = entry->hook;
+
+	Array args;
+	args.append(Ref<LuaAPI>(this));
+	args.append(ar->event);
+	args.append(ar->currentline);
+
+	// Lets get_running_coroutine see the thread the hook runs on
+	int top = lua_gettop(state);
+	NativeCall previous = beginNativeCall(state);
+
+#ifndef LAPI_GDEXTENSION
+	const int argc = 3;
+	const Variant *p_args[argc];
+	for (int i = 0; i < argc; i++) {
+		p_args[i] = &args[i];
+	}
+
+	Variant returned;
+	Callable::CallError error;
+	hook.callp(p_args, argc, returned, error);
+	endNativeCall(previous);
+	lua_settop(state, top);
+	if (error.error != error.CALL_OK) {
+		Ref<LuaError> err = LuaState::handleError(hook.get_method(), error, p_args, argc);
+		lua_pushstring(state, err->getMessage().utf8().get_data());
+		return false;
+	}
+#else
+	Variant returned = hook.callv(args);
+	endNativeCall(previous);
+	lua_settop(state, top);
+#endif
+
+	// Returning a LuaError raises it
+	if (returned.get_type() == Variant::OBJECT) {
+#ifndef LAPI_GDEXTENSION
+		LuaError *err = Object::cast_to<LuaError>(returned.operator Object *());
+#else
+		// blame this on https://github.com/godotengine/godot-cpp/issues/995
+		LuaError *err = dynamic_cast<LuaError *>(returned.operator Object *());
+#endif
+		if (err != nullptr) {
+			lua_pushstring(state, err->getMessage().utf8().get_data());
+			return false;
+		}
+	}
+	return true;
+}
+
 int LuaAPI::configureGC(int what, int data) {
 	return lua_gc(lState, what, data);
 }
@@ -107,6 +657,348 @@ uint64_t LuaAPI::getMemoryLimit() const {
 	return luaAllocData.memoryLimit;
 }
 
+void LuaAPI::setDeferredFinalization(bool value) {
+	deferredFinalization = value;
+}
+
+bool LuaAPI::getDeferredFinalization() const {
+	return deferredFinalization;
+}
+
+void LuaAPI::setFinalizerBudgetCount(int value) {
+	finalizerBudgetCount = value;
+}
+
+int LuaAPI::getFinalizerBudgetCount() const {
+	return finalizerBudgetCount;
+}
+
+void LuaAPI::setFinalizerBudgetUsec(int value) {
+	finalizerBudgetUsec = value;
+}
+
+int LuaAPI::getFinalizerBudgetUsec() const {
+	return finalizerBudgetUsec;
+}
+
+// Calls the LuaObjectMetatable __gc for an object that was collected by Lua.
+Ref<LuaError> LuaAPI::runFinalizer(Ref<LuaAPI> api, const Variant &obj) {
+	Ref<LuaObjectMetatable> mt = obj.get("lua_metatable");
+	// Sometimes the api ref is cleaned up first, so we need to check for that
+	if (!mt.is_valid() && api.is_valid()) {
+		mt = api->getObjectMetatable();
+	}
+
+	if (mt.is_valid()) {
+		return mt->__gc(obj, api);
+	}
+
+	return nullptr;
+}
+
+// Keeps the object alive until drainFinalizers() gets to it.
+void LuaAPI::queueFinalizer(const Variant &obj) {
+	finalizerQueue.push_back(obj);
+	uint32_t pending = finalizerQueue.size() - finalizerHead;
+	if (pending > finalizerPeak) {
+		finalizerPeak = pending;
+	}
+}
+
+// Runs queued finalizers until the queue is empty or one of the budgets is used up. Returns how many were run.
+int LuaAPI::drainFinalizers() {
+	uint64_t start = finalizerBudgetUsec > 0 ? get_ticks_usec() : 0;
+	int count = 0;
+	while (finalizerHead < finalizerQueue.size()) {
+		if (finalizerBudgetCount > 0 && count >= finalizerBudgetCount) {
+			break;
+		}
+
+		if (finalizerBudgetUsec > 0 && count > 0 && get_ticks_usec() - start >= (uint64_t)finalizerBudgetUsec) {
+			break;
+		}
+
+		// Move the object out first, the finalizer may queue more objects.
+		Variant obj = finalizerQueue[finalizerHead];
+		finalizerQueue[finalizerHead] = Variant();
+		finalizerHead++;
+
+		Ref<LuaError> err = runFinalizer(this, obj);
+		if (!err.is_null()) {
+			print_error(err->getMessage());
+		}
+		count++;
+	}
+
+	// With a budget and a steady inflow the queue may never empty, so the drained prefix is dropped once it is the larger half.
+	// That keeps the buffer proportional to the pending count instead of to every object ever finalized.
+	if (finalizerHead == finalizerQueue.size()) {
+		finalizerQueue.clear();
+		finalizerHead = 0;
+	} else if (finalizerHead > finalizerQueue.size() / 2) {
+		uint32_t pending = finalizerQueue.size() - finalizerHead;
+		for (uint32_t i = 0; i < pending; i++) {
+			finalizerQueue[i] = finalizerQueue[finalizerHead + i];
+		}
+		finalizerQueue.resize(pending);
+		finalizerHead = 0;
+	}
+
+	return count;
+}
+
+int LuaAPI::getPendingFinalizerCount() const {
+	return finalizerQueue.size() - finalizerHead;
+}
+
+int LuaAPI::getPeakFinalizerCount() const {
+	return finalizerPeak;
+}
+
+void LuaAPI::setTracebackMode(TracebackMode mode) {
+	tracebackMode = mode;
+}
+
+LuaAPI::TracebackMode LuaAPI::getTracebackMode() const {
+	return tracebackMode;
+}
+
+Vector<LuaError::TraceFrame> &LuaAPI::getPendingTrace() {
+	return pendingTrace;
+}
+
+void LuaAPI::setReportExternalMemory(bool value) {
+	reportExternalMemory = value;
+}
+
+bool LuaAPI::getReportExternalMemory() const {
+	return reportExternalMemory;
+}
+
+// Asks the objects metatable how much memory outside of Lua the object keeps alive.
+uint64_t LuaAPI::estimateExternalSize(const Variant &obj) {
+	Ref<LuaObjectMetatable> mt = obj.get("lua_metatable");
+	if (!mt.is_valid()) {
+		mt = objectMetatable;
+	}
+
+	if (!mt.is_valid()) {
+		return 0;
+	}
+
+	int64_t size = mt->__external_size(obj, this);
+	return size > 0 ? (uint64_t)size : 0;
+}
+
+// Adds the size to the collectors debt so objects holding large resources get collected sooner.
+// Lua 5.4 keeps the added debt, so later allocations keep stepping until it is paid off. LuaJIT has no way to add debt,
+// there the same amount of collection work is done right away and nothing carries over to later allocations.
+void LuaAPI::addExternalMemory(lua_State *state, uint64_t size) {
+	externalMemoryUsed += size;
+
+	uint64_t kb = size / 1024;
+	if (kb > 0) {
+		lua_gc(state, LUA_GCSTEP, kb > INT32_MAX ? INT32_MAX : (int)kb);
+	}
+}
+
+void LuaAPI::removeExternalMemory(uint64_t size) {
+	externalMemoryUsed -= size > externalMemoryUsed ? externalMemoryUsed : size;
+}
+
+uint64_t LuaAPI::getExternalMemoryUsage() const {
+	return externalMemoryUsed;
+}
+
+// Called by the Lua -> Godot trampolines around the call. Returns the previous call, which must be passed to endNativeCall.
+LuaAPI::NativeCall LuaAPI::beginNativeCall(lua_State *state) {
+	NativeCall previous = activeCall;
+	activeCall.state = state;
+	activeCall.pushed = 0;
+	return previous;
+}
+
+// Returns how many values return_values() pushed during the call.
+int LuaAPI::endNativeCall(const NativeCall &previous) {
+	int pushed = activeCall.pushed;
+	activeCall = previous;
+	return pushed;
+}
+
+LuaJob *LuaAPI::swapRunningJob(LuaJob *job) {
+	LuaJob *previous = runningJob;
+	runningJob = job;
+	return previous;
+}
+
+LuaJob *LuaAPI::getRunningJob() const {
+	return runningJob;
+}
+
+// Pushes every argument straight onto the stack of the Lua call currently running the caller. When any values were pushed, they are returned to Lua instead of the callers return value.
+#ifndef LAPI_GDEXTENSION
+Variant LuaAPI::returnValues(const Variant **args, int argc, Callable::CallError &error) {
+	error.error = Callable::CallError::CALL_OK;
+#else
+Variant LuaAPI::returnValues(const Variant **args, GDExtensionInt argc, GDExtensionCallError &error) {
+	error.error = GDEXTENSION_CALL_OK;
+#endif
+	if (activeCall.state == nullptr) {
+		return LuaError::newError("return_values() can only be used while Lua is calling a function.", LuaError::ERR_RUNTIME);
+	}
+
+	// Checked up front, pushVariant raises a LuaError with lua_error which would unwind through the caller
+	for (int i = 0; i < argc; i++) {
+		Ref<LuaError> err = LuaState::checkPushable(*args[i]);
+		if (err.is_valid()) {
+			return LuaError::newError(vformat("return_values() argument %d can not be passed to Lua: %s", i, err->getMessage()), LuaError::ERR_TYPE);
+		}
+	}
+
+	if (!lua_checkstack(activeCall.state, argc)) {
+		return LuaError::newError("Lua stack overflow while pushing the return values.", LuaError::ERR_RUNTIME);
+	}
+
+	// A LuaTuple pushes each of its values
+	int top = lua_gettop(activeCall.state);
+	for (int i = 0; i < argc; i++) {
+		LuaState::pushVariant(activeCall.state, *args[i]);
+	}
+	activeCall.pushed += lua_gettop(activeCall.state) - top;
+
+	return Variant();
+}
+
+// Returns a registry ref to the function at index, shared with every other handle to the same function.
+// Each call must be paired with a call to releaseFunctionRef.
+int LuaAPI::acquireFunctionRef(lua_State *state, int index) {
+	const void *function = lua_topointer(state, index);
+	if (SharedFunctionRef *shared = functionRefs.getptr(function); shared != nullptr) {
+		shared->count++;
+		return shared->ref;
+	}
+
+	lua_pushvalue(state, index);
+	SharedFunctionRef shared;
+	shared.ref = luaL_ref(state, LUA_REGISTRYINDEX);
+	shared.count = 1;
+	functionRefs.insert(function, shared);
+	return shared.ref;
+}
+
+// funcRef is the instance id of the LuaFunctionRef releasing the ref, if it was one.
+void LuaAPI::releaseFunctionRef(const void *function, ObjectID funcRef) {
+	if (closing) {
+		return;
+	}
+
+	SharedFunctionRef *shared = functionRefs.getptr(function);
+	ERR_FAIL_NULL(shared);
+	if (shared->funcRef == funcRef) {
+		shared->funcRef = ObjectID();
+	}
+
+	if (--shared->count > 0) {
+		return;
+	}
+
+	luaL_unref(lState, LUA_REGISTRYINDEX, shared->ref);
+	functionRefs.erase(function);
+}
+
+// Returns the LuaFunctionRef for the function at index. Pulling the same function again returns the same object while it is alive.
+Ref<LuaFunctionRef> LuaAPI::getFunctionRef(lua_State *state, int index) {
+	const void *function = lua_topointer(state, index);
+	if (SharedFunctionRef *shared = functionRefs.getptr(function); shared != nullptr && shared->funcRef.is_valid()) {
+#ifndef LAPI_GDEXTENSION
+		LuaFunctionRef *existing = Object::cast_to<LuaFunctionRef>(ObjectDB::get_instance(shared->funcRef));
+#else
+		// blame this on https://github.com/godotengine/godot-cpp/issues/995
+		LuaFunctionRef *existing = dynamic_cast<LuaFunctionRef *>(ObjectDB::get_instance(shared->funcRef));
+#endif
+		if (existing != nullptr) {
+			return Ref<LuaFunctionRef>(existing);
+		}
+	}
+
+	Ref<LuaFunctionRef> funcRef;
+	funcRef.instantiate();
+	funcRef->setRef(acquireFunctionRef(state, index));
+	funcRef->setShared(get_instance_id(), function);
+	funcRef->setErrorHandlerRef(this->state.getErrorHandlerRef());
+	// Not the calling thread, it may be pooled and reused by another coroutine while the handle lives
+	funcRef->setLuaState(lState);
+	functionRefs.getptr(function)->funcRef = funcRef->get_instance_id();
+	return funcRef;
+}
+
+// Parses the path once. Returns -1 when the cache is full, the caller should resolve the path itself.
+int LuaAPI::internNodePath(const String &path) {
+	if (nodePaths.size() >= MAX_CACHED_NODE_PATHS) {
+		return -1;
+	}
+
+	nodePaths.push_back(NodePath(path));
+	return nodePaths.size() - 1;
+}
+
+// Resolves an interned path relative to base. Results are reused until the scene tree changes.
+Object *LuaAPI::getNodeCached(Object *base, int pathId) {
+	Node *node = Object::cast_to<Node>(base);
+	if (node == nullptr) {
+		return nullptr;
+	}
+
+	const NodePath &path = nodePaths[pathId];
+	// Without a tree there is nothing telling us when the result goes stale
+	if (!node->is_inside_tree()) {
+		return node->get_node_or_null(path);
+	}
+
+	SceneTree *tree = node->get_tree();
+	if (tree->get_instance_id() != watchedTree) {
+		// Only the tree the cached nodes live in should keep bumping the version
+		Callable onChanged = callable_mp(this, &LuaAPI::onTreeChanged);
+		Object *oldTree = ObjectDB::get_instance(watchedTree);
+		if (oldTree != nullptr && oldTree->is_connected("tree_changed", onChanged)) {
+			oldTree->disconnect("tree_changed", onChanged);
+		}
+		tree->connect("tree_changed", onChanged);
+		watchedTree = tree->get_instance_id();
+		treeVersion++;
+	}
+
+	// tree_changed fires for every node added or removed, so the cache is dropped here once instead of on every signal.
+	// This also keeps entries for freed bases from piling up.
+	if (resolvedVersion != treeVersion) {
+		resolvedNodes.clear();
+		resolvedVersion = treeVersion;
+	}
+
+	NodeCacheKey key;
+	key.base = node->get_instance_id();
+	key.path = pathId;
+
+	ObjectID *cached = resolvedNodes.getptr(key);
+	if (cached != nullptr) {
+		if (Object *target = ObjectDB::get_instance(*cached); target != nullptr) {
+			return target;
+		}
+	}
+
+	Node *target = node->get_node_or_null(path);
+	if (target == nullptr) {
+		return nullptr;
+	}
+
+	resolvedNodes.insert(key, target->get_instance_id());
+	return target;
+}
+
+void LuaAPI::onTreeChanged() {
+	treeVersion++;
+}
+
 Variant LuaAPI::getRegistryValue(String name) {
 	return state.getRegistryValue(name);
 }
@@ -129,21 +1021,53 @@ Variant LuaAPI::pullVariant(String name) {
 	return state.pullVariant(name);
 }
 
+// Calls LuaState::pullVariants()
+Array LuaAPI::pullVariants(PackedStringArray names) {
+	return state.pullVariants(names);
+}
+
+// Calls LuaState::pushGlobalFunction()
+bool LuaAPI::pushGlobalFunction(const String &functionName) {
+	return state.pushGlobalFunction(functionName);
+}
+
+// Calls LuaState::pushGlobalValue()
+bool LuaAPI::pushGlobalValue(const String &name, int type) {
+	return state.pushGlobalValue(name, type);
+}
+
 // Calls LuaState::callFunction()
 Variant LuaAPI::callFunction(String functionName, Array args) {
 	return state.callFunction(functionName, args);
 }
 
+// Calls LuaState::callFunctionBatch()
+Variant LuaAPI::callFunctionBatch(String functionName, Array args, Array results) {
+	return state.callFunctionBatch(functionName, args, results);
+}
+
+// Calls LuaState::callFunctionInto()
+Ref<LuaError> LuaAPI::callFunctionInto(String functionName, Array args, Array results) {
+	return state.callFunctionInto(functionName, args, results);
+}
+
+// Calls LuaState::getFunctionHandle()
+Variant LuaAPI::getFunctionHandle(String functionName) {
+	return state.getFunctionHandle(functionName);
+}
+
 // Calls LuaState::pushGlobalVariant()
 Ref<LuaError> LuaAPI::pushGlobalVariant(String name, Variant var) {
 	return state.pushGlobalVariant(name, var);
 }
 
+// Calls LuaState::pushGlobalVariants()
+Dictionary LuaAPI::pushGlobalVariants(Dictionary vars) {
+	return state.pushGlobalVariants(vars);
+}
+
 // addFile() calls luaL_loadfille with the absolute file path
 Variant LuaAPI::doFile(String fileName, Array args) {
-	// push the error handler onto the stack
-	lua_pushcfunction(lState, LuaState::luaErrorHandler);
-
 	String path;
 	// fileAccess never unrefs without this
 	{
@@ -163,9 +1087,17 @@ Variant LuaAPI::doFile(String fileName, Array args) {
 		path = file->get_path_absolute();
 	}
 
+	// Restored before returning, so a do_file from a function Lua is calling leaves that call's stack as it was
+	int top = lua_gettop(lState);
+
+	// push the error handler onto the stack
+	lua_pushcfunction(lState, LuaState::luaErrorHandler);
+
 	int err = luaL_loadfile(lState, path.utf8().get_data());
 	if (err != LUA_OK) {
-		return state.handleError(err);
+		Ref<LuaError> loadError = state.handleError(err);
+		lua_settop(lState, top);
+		return loadError;
 	}
 
 	int argc = args.size();
@@ -176,19 +1108,24 @@ Variant LuaAPI::doFile(String fileName, Array args) {
 	int handlerIndex = -2 - argc;
 
 	Variant ret = execute(argc, handlerIndex);
-	// pop the error handler from the stack
-	lua_pop(lState, 1);
+	// pop the error handler and the result from the stack
+	lua_settop(lState, top);
 	return ret;
 }
 
 // Loads string into lua state and executes the top of the stack
 Variant LuaAPI::doString(String code, Array args) {
+	// Restored before returning, so a do_string from a function Lua is calling leaves that call's stack as it was
+	int top = lua_gettop(lState);
+
 	// push the error handler onto the stack
 	lua_pushcfunction(lState, LuaState::luaErrorHandler);
 
 	int err = luaL_loadstring(lState, code.utf8().get_data());
 	if (err != LUA_OK) {
-		return state.handleError(err);
+		Ref<LuaError> loadError = state.handleError(err);
+		lua_settop(lState, top);
+		return loadError;
 	}
 
 	int argc = args.size();
@@ -199,13 +1136,42 @@ Variant LuaAPI::doString(String code, Array args) {
 	int handlerIndex = -2 - argc;
 
 	Variant ret = execute(argc, handlerIndex);
-	// pop the error handler from the stack
-	lua_pop(lState, 1);
+	// pop the error handler and the result from the stack
+	lua_settop(lState, top);
 	return ret;
 }
 
+// Loads the string as a LuaJob, which runs it a slice at a time with LuaJob.step. Returns the job or a LuaError.
+Variant LuaAPI::doStringJob(String code, Array args) {
+	int err = luaL_loadstring(lState, code.utf8().get_data());
+	if (err != LUA_OK) {
+		return state.handleError(err);
+	}
+	return startJob(args);
+}
+
+// Same as do_string_job, but for a function already defined in Lua
+Variant LuaAPI::callFunctionJob(String functionName, Array args) {
+	if (!pushGlobalFunction(functionName)) {
+		return LuaError::newError(vformat("Function \"%s\" does not exist.", functionName), LuaError::ERR_RUNTIME);
+	}
+	return startJob(args);
+}
+
+// Hands the function on top of the stack to a new LuaJob
+Variant LuaAPI::startJob(Array args) {
+	Ref<LuaJob> job;
+	job.instantiate();
+	Ref<LuaError> err = job->start(this, args);
+	if (err.is_valid()) {
+		return err;
+	}
+	return job;
+}
+
 // Execute the current lua stack, return error as string if one occurs, otherwise return String()
 Variant LuaAPI::execute(int argc, int handlerIndex) {
+	ExecutionScope scope(this, lState);
 	int err = lua_pcall(lState, argc, 1, handlerIndex);
 	if (err != LUA_OK) {
 		return state.handleError(err);
@@ -221,23 +1187,248 @@ Ref<LuaCoroutine> LuaAPI::newCoroutine() {
 	return thread;
 }
 
+// Returns the coroutine whose Lua code is calling into Godot right now, or null when it is the main state.
 Ref<LuaCoroutine> LuaAPI::getRunningCoroutine() {
-	Variant top = state.getVar();
-	if (top.get_type() != Variant::Type::OBJECT) {
+	lua_State *running = activeCall.state;
+	if (running == nullptr || running == lState) {
 		return nullptr;
 	}
 
+	lua_pushthread(running);
+	Ref<LuaCoroutine> thread = getCoroutine(running, -1);
+	lua_pop(running, 1);
+	return thread;
+}
+
+// Hands out a pooled thread, or a new one anchored in the registry.
+lua_State *LuaAPI::acquireThread(ObjectID wrapper) {
+	if (!threadPool.is_empty()) {
+		lua_State *thread = threadPool[threadPool.size() - 1];
+		threadPool.resize(threadPool.size() - 1);
+		threads.getptr(thread)->wrapper = wrapper;
+		return thread;
+	}
+
+	lua_State *thread = lua_newthread(lState);
+	ThreadEntry entry;
+	entry.ref = luaL_ref(lState, LUA_REGISTRYINDEX);
+	entry.wrapper = wrapper;
+	entry.owned = true;
+	threads.insert(thread, entry);
+	return thread;
+}
+
+// Called when a LuaCoroutine lets go of its thread. Owned threads that can be reset are pooled, the rest are unanchored.
+void LuaAPI::releaseThread(lua_State *thread) {
+	if (closing) {
+		return;
+	}
+
+	ThreadEntry *entry = threads.getptr(thread);
+	ERR_FAIL_NULL(entry);
+	entry->wrapper = ObjectID();
+	threadHooks.erase(thread);
+
+	// The await connection keeps it alive until the signal fires, it can not be handed out before that
+	// A thread Lua may still reference is left to the collector, reusing it would hand the same thread to two owners
+	if (entry->owned && !entry->exposed && !awaitingThreads.has(thread) && threadPool.size() < MAX_POOLED_THREADS && resetThread(thread)) {
+		threadPool.push_back(thread);
+		return;
+	}
+
+	luaL_unref(lState, LUA_REGISTRYINDEX, entry->ref);
+	threads.erase(thread);
+}
+
+// Returns the LuaCoroutine for the thread at index. The same thread gives the same object while it is alive.
+Ref<LuaCoroutine> LuaAPI::getCoroutine(lua_State *state, int index) {
+	lua_State *thread = lua_tothread(state, index);
+	exposeThread(thread);
+	ThreadEntry *entry = threads.getptr(thread);
+	if (entry != nullptr && entry->wrapper.is_valid()) {
 #ifndef LAPI_GDEXTENSION
-	Ref<LuaCoroutine> thread = Object::cast_to<LuaCoroutine>(top);
+		LuaCoroutine *existing = Object::cast_to<LuaCoroutine>(ObjectDB::get_instance(entry->wrapper));
 #else
-	Ref<LuaCoroutine> thread = dynamic_cast<LuaCoroutine *>(top.operator Object *());
+		// blame this on https://github.com/godotengine/godot-cpp/issues/995
+		LuaCoroutine *existing = dynamic_cast<LuaCoroutine *>(ObjectDB::get_instance(entry->wrapper));
 #endif
-	return thread;
+		if (existing != nullptr) {
+			return Ref<LuaCoroutine>(existing);
+		}
+	}
+
+	if (entry == nullptr) {
+		ThreadEntry newEntry;
+		lua_pushvalue(state, index);
+		newEntry.ref = luaL_ref(state, LUA_REGISTRYINDEX);
+		newEntry.exposed = true;
+		entry = &threads.insert(thread, newEntry)->value;
+	}
+
+	Ref<LuaCoroutine> coroutine;
+	coroutine.instantiate();
+	entry->wrapper = coroutine->get_instance_id();
+	coroutine->bindExisting(this, thread);
+	return coroutine;
 }
 
-// Creates a new thread staee
-lua_State *LuaAPI::newThreadState() {
-	return lua_newthread(lState);
+// Marks a thread Lua holds a reference to, so releaseThread leaves it to the collector instead of pooling it
+void LuaAPI::exposeThread(lua_State *thread) {
+	ThreadEntry *entry = threads.getptr(thread);
+	if (entry == nullptr || entry->exposed) {
+		return;
+	}
+
+	entry->exposed = true;
+	// Lua kept a reference past the last wrapper, so the thread may be sitting in the pool
+	if (entry->owned && entry->wrapper.is_null()) {
+		threadPool.erase(thread);
+	}
+}
+
+int LuaAPI::getPooledThreadCount() const {
+	return threadPool.size();
+}
+
+// Called by await before it connects, returns the token the connection resumes with
+uint64_t LuaAPI::beginAwait(lua_State *thread) {
+	AwaitEntry entry;
+	entry.token = ++lastAwaitToken;
+	awaitingThreads.insert(thread, entry);
+	return entry.token;
+}
+
+// Called when the await connection goes away, fired or not
+void LuaAPI::endAwait(lua_State *thread, uint64_t token) {
+	AwaitEntry *entry = awaitingThreads.getptr(thread);
+	if (entry != nullptr && entry->token == token) {
+		awaitingThreads.erase(thread);
+	}
+}
+
+// Called when await returns in the thread. A signal firing after that must not resume it, whatever resumed it first.
+void LuaAPI::finishAwait(lua_State *thread) {
+	awaitingThreads.erase(thread);
+}
+
+// Used by LuaScheduler so the signal resumes the task from its own queues
+void LuaAPI::setAwaitOwner(lua_State *thread, Object *owner, AwaitResumeFunc resume, int64_t data) {
+	AwaitEntry *entry = awaitingThreads.getptr(thread);
+	ERR_FAIL_NULL(entry);
+	entry->owner = owner->get_instance_id();
+	entry->resume = resume;
+	entry->data = data;
+}
+
+bool LuaAPI::isAwaiting(lua_State *thread) const {
+	return awaitingThreads.has(thread);
+}
+
+// Resumes a thread whose awaited signal fired. The owner set with setAwaitOwner goes first, then the LuaCoroutine wrapping the thread.
+void LuaAPI::resumeAwaited(lua_State *thread, uint64_t token, const Variant **args, int argc) {
+	AwaitEntry *entry = awaitingThreads.getptr(thread);
+	if (entry == nullptr || entry->token != token) {
+		return;
+	}
+
+	AwaitEntry awaited = *entry;
+	awaitingThreads.erase(thread);
+
+	// Resumed by something else in the meantime
+	if (lua_status(thread) != LUA_YIELD) {
+		return;
+	}
+
+	if (awaited.resume != nullptr) {
+		Object *owner = ObjectDB::get_instance(awaited.owner);
+		if (owner != nullptr) {
+			awaited.resume(owner, thread, awaited.data, args, argc);
+		}
+		return;
+	}
+
+	ThreadEntry *threadEntry = threads.getptr(thread);
+	if (threadEntry != nullptr && threadEntry->wrapper.is_valid()) {
+#ifndef LAPI_GDEXTENSION
+		LuaCoroutine *coroutine = Object::cast_to<LuaCoroutine>(ObjectDB::get_instance(threadEntry->wrapper));
+#else
+		// blame this on https://github.com/godotengine/godot-cpp/issues/995
+		LuaCoroutine *coroutine = dynamic_cast<LuaCoroutine *>(ObjectDB::get_instance(threadEntry->wrapper));
+#endif
+		if (coroutine != nullptr) {
+			coroutine->resumeAwaited(args, argc);
+			return;
+		}
+	}
+
+	resumeDetached(thread, args, argc);
+}
+
+// Nobody is resuming the thread, so it runs until it awaits again or finishes. Errors are printed since there is no one to return them to.
+void LuaAPI::resumeDetached(lua_State *thread, const Variant **args, int argc) {
+	// The thread is not running, so values pushVariant would fail on or raise are passed as nil instead
+	int top = lua_gettop(thread);
+	for (int i = 0; i < argc; i++) {
+		if (LuaState::checkPushable(*args[i]).is_valid()) {
+			lua_pushnil(thread);
+		} else {
+			LuaState::pushVariant(thread, *args[i]);
+		}
+	}
+	int nargs = lua_gettop(thread) - top;
+
+	ExecutionScope scope(this, thread);
+#ifndef LAPI_LUAJIT
+	int nresults = 0;
+	int ret = lua_resume(thread, nullptr, nargs, &nresults);
+#else
+	int ret = lua_resume(thread, nargs);
+	int nresults = lua_gettop(thread);
+#endif
+
+	if (ret != LUA_OK && ret != LUA_YIELD) {
+		Ref<LuaError> err = LuaState::handleError(thread, ret);
+		print_error(err->getMessage());
+		return;
+	}
+
+	lua_pop(thread, nresults);
+}
+
+// Drops a registry ref taken outside of LuaState, unless the state is already closing
+void LuaAPI::releaseRef(int ref) {
+	if (closing) {
+		return;
+	}
+	luaL_unref(lState, LUA_REGISTRYINDEX, ref);
+}
+
+// Readies a finished thread for reuse. Returns false if it can not be reused.
+bool LuaAPI::resetThread(lua_State *thread) {
+	// Running, or resuming another coroutine
+	lua_Debug ar;
+	if (lua_status(thread) == LUA_OK && lua_getstack(thread, 0, &ar)) {
+		return false;
+	}
+
+#ifndef LAPI_LUAJIT
+	// Also closes pending to-be-closed variables of suspended threads
+#if LUA_VERSION_RELEASE_NUM >= 50406
+	lua_closethread(thread, nullptr);
+#else
+	lua_resetthread(thread);
+#endif
+	// Hooks are per thread in 5.4, the next owner should not inherit one
+	lua_sethook(thread, nullptr, 0, 0);
+	return true;
+#else
+	// LuaJIT can not reset a thread, only ones that finished without an error are reusable
+	if (lua_status(thread) != LUA_OK) {
+		return false;
+	}
+	lua_settop(thread, 0);
+	return true;
+#endif
 }
 
 // returns state
@@ -245,6 +1436,11 @@ lua_State *LuaAPI::getState() {
 	return lState;
 }
 
+// Registry ref to LuaState::luaErrorHandler, so callers do not have to push a new C function for every call
+int LuaAPI::getErrorHandlerRef() const {
+	return state.getErrorHandlerRef();
+}
+
 void *LuaAPI::luaAlloc(void *ud, void *ptr, size_t osize, size_t nsize) {
 	LuaAllocData *data = (LuaAllocData *)ud;
 	if (nsize == 0) {
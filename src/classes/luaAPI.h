@@ -4,12 +4,22 @@
 #ifndef LAPI_GDEXTENSION
 #include "core/core_bind.h"
 #include "core/object/ref_counted.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/local_vector.h"
+#include "core/templates/safe_refcount.h"
+#include "core/os/mutex.h"
 #else
+#include <godot_cpp/classes/mutex.hpp>
 #include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/core/mutex_lock.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
+#include <godot_cpp/templates/safe_refcount.hpp>
 #endif
 
 #include "luaError.h"
 
+#include <luaEventQueue.h>
 #include <luaState.h>
 #include <lua/lua.hpp>
 
@@ -18,6 +28,8 @@ using namespace godot;
 #endif
 
 class LuaCoroutine;
+class LuaFunctionRef;
+class LuaJob;
 class LuaObjectMetatable;
 
 class LuaAPI : public RefCounted {
@@ -31,6 +43,56 @@ public:
 	~LuaAPI();
 
 	void setHook(Callable hook, int mask, int count);
+	void setHookFilter(Dictionary breakpoints, PackedStringArray functions);
+	void setThreadHook(lua_State *thread, Callable hook, int mask, int count);
+	void setThreadHookFilter(lua_State *thread, Dictionary breakpoints, PackedStringArray functions);
+	void refreshHook(lua_State *thread);
+
+	void setExecutionLimit(int64_t instructions, int64_t usec);
+	int64_t getInstructionLimit() const;
+	int64_t getTimeLimitUsec() const;
+
+	void setExecutionLimitYields(bool value);
+	bool getExecutionLimitYields() const;
+
+	void requestInterrupt();
+
+	void postEvent(Variant event);
+	Variant drainEvents(Variant handler, int max);
+	int64_t getPendingEventCount() const;
+
+	// Marks a call from Godot into Lua. Execution limits are counted from the outermost one.
+	class ExecutionScope {
+	public:
+		ExecutionScope(LuaAPI *api, lua_State *state) :
+				api(api) {
+			previous = api->beginExecution(state);
+		}
+		~ExecutionScope() {
+			api->endExecution(previous);
+		}
+
+	private:
+		LuaAPI *api;
+		lua_State *previous;
+	};
+
+	// Returns the thread entered before, to be passed to endExecution
+	lua_State *beginExecution(lua_State *state);
+	void endExecution(lua_State *previous);
+	bool executionLimitHit() const;
+	bool executionLimitYielded() const;
+	bool executionInterrupted() const;
+
+	enum LimitAction {
+		LIMIT_NONE,
+		LIMIT_RAISE,
+		LIMIT_YIELD,
+	};
+
+	LimitAction checkExecutionLimit(lua_State *state, int count);
+	LimitAction checkInterrupt(lua_State *state, bool canYield);
+	bool dispatchHook(lua_State *state, lua_Debug *ar);
 
 	void setUseCallables(bool value);
 	bool getUseCallables() const;
@@ -44,23 +106,109 @@ public:
 	int configureGC(int what, int data);
 	uint64_t getMemoryUsage() const;
 
+	void setDeferredFinalization(bool value);
+	bool getDeferredFinalization() const;
+
+	void setFinalizerBudgetCount(int value);
+	int getFinalizerBudgetCount() const;
+
+	void setFinalizerBudgetUsec(int value);
+	int getFinalizerBudgetUsec() const;
+
+	static Ref<LuaError> runFinalizer(Ref<LuaAPI> api, const Variant &obj);
+
+	void queueFinalizer(const Variant &obj);
+	int drainFinalizers();
+	int getPendingFinalizerCount() const;
+	int getPeakFinalizerCount() const;
+
+	enum TracebackMode {
+		TRACEBACK_FULL,
+		TRACEBACK_NONE,
+		TRACEBACK_LAZY,
+	};
+
+	void setTracebackMode(TracebackMode mode);
+	TracebackMode getTracebackMode() const;
+	Vector<LuaError::TraceFrame> &getPendingTrace();
+
+	void setReportExternalMemory(bool value);
+	bool getReportExternalMemory() const;
+
+	uint64_t estimateExternalSize(const Variant &obj);
+	void addExternalMemory(lua_State *state, uint64_t size);
+	void removeExternalMemory(uint64_t size);
+	uint64_t getExternalMemoryUsage() const;
+
+	int acquireFunctionRef(lua_State *state, int index);
+	void releaseFunctionRef(const void *function, ObjectID funcRef = ObjectID());
+	Ref<LuaFunctionRef> getFunctionRef(lua_State *state, int index);
+
+	int internNodePath(const String &path);
+	Object *getNodeCached(Object *base, int pathId);
+
 	bool luaFunctionExists(String functionName);
 
 	Variant pullVariant(String name);
+	Array pullVariants(PackedStringArray names);
 	Variant callFunction(String functionName, Array args);
+	Variant getFunctionHandle(String functionName);
+	bool pushGlobalFunction(const String &functionName);
+	bool pushGlobalValue(const String &name, int type);
+	Variant callFunctionBatch(String functionName, Array args, Array results);
+	Ref<LuaError> callFunctionInto(String functionName, Array args, Array results);
 	Variant doFile(String fileName, Array args);
 	Variant doString(String code, Array args);
+	Variant doStringJob(String code, Array args);
+	Variant callFunctionJob(String functionName, Array args);
 	Variant getRegistryValue(String name);
 
 	Ref<LuaError> setRegistryValue(String name, Variant var);
 	Ref<LuaError> bindLibraries(TypedArray<String> libs);
 	Ref<LuaError> pushGlobalVariant(String name, Variant var);
+	Dictionary pushGlobalVariants(Dictionary vars);
 
 	Ref<LuaCoroutine> newCoroutine();
 	Ref<LuaCoroutine> getRunningCoroutine();
 
-	lua_State *newThreadState();
+	lua_State *acquireThread(ObjectID wrapper);
+	void releaseThread(lua_State *thread);
+	Ref<LuaCoroutine> getCoroutine(lua_State *state, int index);
+	void exposeThread(lua_State *thread);
+	int getPooledThreadCount() const;
+
+	// Whoever resumed a thread that yielded from await can take over resuming it once the signal fires
+	typedef void (*AwaitResumeFunc)(Object *owner, lua_State *thread, int64_t data, const Variant **args, int argc);
+
+	uint64_t beginAwait(lua_State *thread);
+	void endAwait(lua_State *thread, uint64_t token);
+	void finishAwait(lua_State *thread);
+	void setAwaitOwner(lua_State *thread, Object *owner, AwaitResumeFunc resume, int64_t data);
+	void resumeAwaited(lua_State *thread, uint64_t token, const Variant **args, int argc);
+	bool isAwaiting(lua_State *thread) const;
+	void releaseRef(int ref);
+
 	lua_State *getState();
+	int getErrorHandlerRef() const;
+
+	// The innermost call from Lua into Godot, return_values() pushes onto its stack
+	struct NativeCall {
+		lua_State *state = nullptr;
+		int pushed = 0; // Values pushed by return_values(), counted instead of read off the stack since nested calls may use it too
+	};
+
+	NativeCall beginNativeCall(lua_State *state);
+	int endNativeCall(const NativeCall &previous);
+
+	// The job being stepped, read by its count hook. Returns the previous one.
+	LuaJob *swapRunningJob(LuaJob *job);
+	LuaJob *getRunningJob() const;
+
+#ifndef LAPI_GDEXTENSION
+	Variant returnValues(const Variant **args, int argc, Callable::CallError &error);
+#else
+	Variant returnValues(const Variant **args, GDExtensionInt argc, GDExtensionCallError &error);
+#endif
 
 	enum HookMask {
 		HOOK_MASK_CALL = LUA_MASKCALL,
@@ -88,6 +236,144 @@ private:
 
 	Ref<LuaObjectMetatable> objectMetatable;
 
+	NativeCall activeCall;
+	LuaJob *runningJob = nullptr;
+
+	// Hooks set from GDScript. Without an entry of its own a thread uses the main state's, like threads inheriting the hook.
+	// Decides which line, call and return events reach the hook, checked before any Variant is built. Empty means no filtering.
+	struct HookFilter {
+		HashMap<int, LocalVector<CharString>> lines; // Line to the chunk names with a breakpoint on it, an empty name matches any chunk
+		LocalVector<CharString> functions;
+
+		bool allowsLine(lua_State *state, lua_Debug *ar) const;
+		bool allowsFunction(lua_State *state, lua_Debug *ar) const;
+	};
+
+	struct ThreadHook {
+		Callable hook;
+		int mask = 0;
+		int count = 0;
+		int counted = 0; // Instructions since the hook was last called for LUA_MASKCOUNT
+		HookFilter filter;
+	};
+
+	HashMap<lua_State *, ThreadHook> threadHooks;
+
+	// Instructions between internal count hooks, the execution limit and LuaJob budgets are checked this often
+	static const int CHECK_INSTRUCTIONS = 1000;
+
+	int64_t instructionLimit = 0;
+	int64_t timeLimitUsec = 0;
+	bool executionLimitYields = false;
+
+	struct Execution {
+		int depth = 0;
+		lua_State *thread = nullptr; // The thread entered by the outermost call, the only one the limit yields
+		uint64_t start = 0;
+		int64_t instructions = 0;
+		bool exceeded = false;
+		bool yielded = false;
+		bool interrupted = false;
+	};
+
+	Execution execution;
+
+	// request_interrupt may come from any thread. enteredThread holds the innermost entered thread, its lowest bit is set while
+	// request_interrupt sets that thread's hook. Entering and leaving never lock, endExecution only waits on the mutex when that bit was set.
+	SafeFlag interruptRequested;
+	SafeNumeric<uintptr_t> enteredThread;
+#ifndef LAPI_GDEXTENSION
+	Mutex interruptMutex;
+#else
+	Ref<Mutex> interruptMutex;
+#endif
+
+	lua_State *publishEnteredThread(lua_State *thread);
+
+	void setInterruptHook(lua_State *thread);
+
+	LuaEventQueue events; // Filled by post_event from any thread, emptied by drain_events
+
+	Variant startJob(Array args);
+
+	// Registry refs shared by every handle to the same Lua function, keyed by lua_topointer. Entries are dropped with the last handle.
+	struct SharedFunctionRef {
+		int ref = LUA_NOREF;
+		uint32_t count = 0;
+		ObjectID funcRef; // The LuaFunctionRef handed out for this function, if one is alive
+	};
+
+	HashMap<const void *, SharedFunctionRef> functionRefs;
+	bool closing = false;
+
+	// Threads handed to LuaCoroutines, anchored in the registry so nothing is left on the main stack.
+	// Threads from new_coroutine are owned and go back to threadPool once their wrapper is gone, others are only anchored while wrapped.
+	struct ThreadEntry {
+		int ref = LUA_NOREF;
+		ObjectID wrapper;
+		bool owned = false;
+		bool exposed = false; // Lua handed it to Godot, so Lua may still reference it and it is never pooled
+	};
+
+	static const uint32_t MAX_POOLED_THREADS = 256;
+	HashMap<lua_State *, ThreadEntry> threads;
+	LocalVector<lua_State *> threadPool;
+
+	static bool resetThread(lua_State *thread);
+
+	// Threads suspended in await, keyed by thread. The token tells a stale connection apart from the current one.
+	struct AwaitEntry {
+		uint64_t token = 0;
+		ObjectID owner;
+		AwaitResumeFunc resume = nullptr;
+		int64_t data = 0;
+	};
+
+	HashMap<lua_State *, AwaitEntry> awaitingThreads;
+	uint64_t lastAwaitToken = 0;
+
+	void resumeDetached(lua_State *thread, const Variant **args, int argc);
+
+	// Objects collected by Lua whose finalizers have not run yet. Entries before finalizerHead were already drained.
+	LocalVector<Variant> finalizerQueue;
+	uint32_t finalizerHead = 0;
+	uint32_t finalizerPeak = 0;
+	bool deferredFinalization = false;
+	int finalizerBudgetCount = 0;
+	int finalizerBudgetUsec = 0;
+
+	TracebackMode tracebackMode = TRACEBACK_FULL;
+	// Frames captured by the error handler in TRACEBACK_LAZY mode, taken by the next LuaState::handleError
+	Vector<LuaError::TraceFrame> pendingTrace;
+
+	bool reportExternalMemory = false;
+	uint64_t externalMemoryUsed = 0;
+
+	// NodePaths parsed from Lua strings. The string to index map lives in the registry under "__NODEPATHS".
+	static const int MAX_CACHED_NODE_PATHS = 4096;
+	LocalVector<NodePath> nodePaths;
+
+	struct NodeCacheKey {
+		ObjectID base;
+		uint32_t path = 0;
+
+		bool operator==(const NodeCacheKey &other) const {
+			return base == other.base && path == other.path;
+		}
+
+		static uint32_t hash(const NodeCacheKey &key) {
+			return hash_murmur3_one_64((uint64_t)key.base, hash_murmur3_one_32(key.path));
+		}
+	};
+
+	// Resolved get_node calls, cleared on the first lookup after the tree changes.
+	HashMap<NodeCacheKey, ObjectID, NodeCacheKey> resolvedNodes;
+	uint64_t treeVersion = 0;
+	uint64_t resolvedVersion = 0;
+	ObjectID watchedTree;
+
+	void onTreeChanged();
+
 	static void *luaAlloc(void *ud, void *ptr, size_t osize, size_t nsize);
 
 	struct LuaAllocData {
@@ -102,5 +388,6 @@ private:
 
 VARIANT_ENUM_CAST(LuaAPI::HookMask)
 VARIANT_ENUM_CAST(LuaAPI::GCOption)
+VARIANT_ENUM_CAST(LuaAPI::TracebackMode)
 
 #endif
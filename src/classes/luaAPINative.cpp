@@ -0,0 +1,260 @@
+#include "luaAPINative.h"
+
+#include <classes/luaAPI.h>
+
+#include <luaState.h>
+
+void LuaAPINative::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_interface", "version"), &LuaAPINative::getInterface, DEFVAL(LUAAPI_INTERFACE_VERSION));
+}
+
+// Returns the address of the interface table, or 0 if version is not supported.
+int64_t LuaAPINative::getInterface(int version) {
+	if (version != LUAAPI_INTERFACE_VERSION) {
+		return 0;
+	}
+
+	return (int64_t)(intptr_t)getInterfaceTable();
+}
+
+// Implementations of the table entries. Most are thin wrappers so callers use the Lua build the state was created with.
+
+static lua_State *nativeGetState(uint64_t id) {
+	Object *obj = ObjectDB::get_instance(ObjectID(id));
+#ifndef LAPI_GDEXTENSION
+	LuaAPI *api = Object::cast_to<LuaAPI>(obj);
+#else
+	// blame this on https://github.com/godotengine/godot-cpp/issues/995
+	LuaAPI *api = dynamic_cast<LuaAPI *>(obj);
+#endif
+	return api != nullptr ? api->getState() : nullptr;
+}
+
+static uint64_t nativeGetApiInstanceId(lua_State *L) {
+	LuaAPI *api = LuaState::getAPI(L);
+	return api != nullptr ? (uint64_t)api->get_instance_id() : 0;
+}
+
+static void nativeRegisterFunction(lua_State *L, const char *name, LuaAPINativeFunction func) {
+	lua_register(L, name, func);
+}
+
+static void nativeRegisterLibrary(lua_State *L, const char *name, const LuaAPINativeReg *funcs) {
+	lua_newtable(L);
+	for (; funcs->name != nullptr; funcs++) {
+		lua_pushcfunction(L, funcs->func);
+		lua_setfield(L, -2, funcs->name);
+	}
+	lua_setglobal(L, name);
+}
+
+static int nativeNewMetatable(lua_State *L, const char *name) {
+	return luaL_newmetatable(L, name);
+}
+
+static void nativeSetMetatable(lua_State *L, const char *name) {
+	luaL_getmetatable(L, name);
+	lua_setmetatable(L, -2);
+}
+
+static void *nativeTestUserdata(lua_State *L, int index, const char *name) {
+	return luaL_testudata(L, index, name);
+}
+
+// Screened first, a LuaError would otherwise be raised through the caller's frames and unsupported types leave a nil behind
+static int nativePushVariant(lua_State *L, const void *variant) {
+	const Variant &var = *(const Variant *)variant;
+	if (LuaState::checkPushable(var).is_valid()) {
+		return 1;
+	}
+	LuaState::pushVariant(L, var);
+	return 0;
+}
+
+static void nativeGetVariant(lua_State *L, int index, void *r_variant) {
+	*(Variant *)r_variant = LuaState::getVariant(L, index);
+}
+
+static int nativeGetTop(lua_State *L) {
+	return lua_gettop(L);
+}
+
+static void nativeSetTop(lua_State *L, int index) {
+	lua_settop(L, index);
+}
+
+static void nativePushValue(lua_State *L, int index) {
+	lua_pushvalue(L, index);
+}
+
+static void nativeRemove(lua_State *L, int index) {
+	lua_remove(L, index);
+}
+
+static int nativeType(lua_State *L, int index) {
+	return lua_type(L, index);
+}
+
+static int nativeUpvalueIndex(int n) {
+	return lua_upvalueindex(n);
+}
+
+static void nativePushNil(lua_State *L) {
+	lua_pushnil(L);
+}
+
+static void nativePushBoolean(lua_State *L, int value) {
+	lua_pushboolean(L, value);
+}
+
+static void nativePushInteger(lua_State *L, int64_t value) {
+	lua_pushinteger(L, (lua_Integer)value);
+}
+
+static void nativePushNumber(lua_State *L, double value) {
+	lua_pushnumber(L, value);
+}
+
+static void nativePushString(lua_State *L, const char *value, size_t length) {
+	lua_pushlstring(L, value, length);
+}
+
+static void nativePushClosure(lua_State *L, LuaAPINativeFunction func, int upvalues) {
+	lua_pushcclosure(L, func, upvalues);
+}
+
+static void nativePushLightUserdata(lua_State *L, void *pointer) {
+	lua_pushlightuserdata(L, pointer);
+}
+
+static int nativeToBoolean(lua_State *L, int index) {
+	return lua_toboolean(L, index);
+}
+
+static int64_t nativeToInteger(lua_State *L, int index) {
+	return (int64_t)lua_tointeger(L, index);
+}
+
+static double nativeToNumber(lua_State *L, int index) {
+	return (double)lua_tonumber(L, index);
+}
+
+static const char *nativeToString(lua_State *L, int index, size_t *r_length) {
+	return lua_tolstring(L, index, r_length);
+}
+
+static void *nativeToUserdata(lua_State *L, int index) {
+	return lua_touserdata(L, index);
+}
+
+static void *nativeNewUserdata(lua_State *L, size_t size) {
+	return lua_newuserdata(L, size);
+}
+
+static void nativeCreateTable(lua_State *L, int arraySize, int hashSize) {
+	lua_createtable(L, arraySize, hashSize);
+}
+
+static void nativeGetField(lua_State *L, int index, const char *key) {
+	lua_getfield(L, index, key);
+}
+
+static void nativeSetField(lua_State *L, int index, const char *key) {
+	lua_setfield(L, index, key);
+}
+
+static void nativeRawGetIndex(lua_State *L, int index, int64_t n) {
+	lua_rawgeti(L, index, n);
+}
+
+static void nativeRawSetIndex(lua_State *L, int index, int64_t n) {
+	lua_rawseti(L, index, n);
+}
+
+static int nativeRef(lua_State *L) {
+	return luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+static void nativeUnref(lua_State *L, int ref) {
+	luaL_unref(L, LUA_REGISTRYINDEX, ref);
+}
+
+static void nativePushRef(lua_State *L, int ref) {
+	lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+}
+
+static int nativePcall(lua_State *L, int nargs, int nresults) {
+	// The handler goes below the function and is removed again once the call is done
+	int handlerIndex = lua_gettop(L) - nargs;
+	lua_pushcfunction(L, LuaState::luaErrorHandler);
+	lua_insert(L, handlerIndex);
+	LuaAPI *api = LuaState::getAPI(L);
+	lua_State *previous = api->beginExecution(L);
+	int ret = lua_pcall(L, nargs, nresults, handlerIndex);
+	api->endExecution(previous);
+	lua_remove(L, handlerIndex);
+	// The message is all the caller gets, frames captured in lazy traceback mode would otherwise go to the next LuaError
+	api->getPendingTrace().clear();
+	return ret;
+}
+
+static int nativeError(lua_State *L, const char *message) {
+	lua_pushstring(L, message);
+	return lua_error(L);
+}
+
+const LuaAPINativeInterface *LuaAPINative::getInterfaceTable() {
+	static const LuaAPINativeInterface table = {
+		LUAAPI_INTERFACE_VERSION,
+		LUA_REGISTRYINDEX,
+
+		nativeGetState,
+		nativeGetApiInstanceId,
+
+		nativeRegisterFunction,
+		nativeRegisterLibrary,
+		nativeNewMetatable,
+		nativeSetMetatable,
+		nativeTestUserdata,
+
+		nativePushVariant,
+		nativeGetVariant,
+
+		nativeGetTop,
+		nativeSetTop,
+		nativePushValue,
+		nativeRemove,
+		nativeType,
+		nativeUpvalueIndex,
+
+		nativePushNil,
+		nativePushBoolean,
+		nativePushInteger,
+		nativePushNumber,
+		nativePushString,
+		nativePushClosure,
+		nativePushLightUserdata,
+
+		nativeToBoolean,
+		nativeToInteger,
+		nativeToNumber,
+		nativeToString,
+		nativeToUserdata,
+
+		nativeNewUserdata,
+		nativeCreateTable,
+		nativeGetField,
+		nativeSetField,
+		nativeRawGetIndex,
+		nativeRawSetIndex,
+
+		nativeRef,
+		nativeUnref,
+		nativePushRef,
+
+		nativePcall,
+		nativeError,
+	};
+
+	return &table;
+}
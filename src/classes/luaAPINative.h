@@ -0,0 +1,31 @@
+#ifndef LUAAPINATIVE_H
+#define LUAAPINATIVE_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/object/class_db.h"
+#include "core/object/object.h"
+#else
+#include <godot_cpp/classes/object.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#endif
+
+#include <luaAPIInterface.h>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+// Engine singleton handing out the LuaAPINativeInterface table to other native extensions.
+class LuaAPINative : public Object {
+	GDCLASS(LuaAPINative, Object);
+
+protected:
+	static void _bind_methods();
+
+public:
+	int64_t getInterface(int version);
+
+	static const LuaAPINativeInterface *getInterfaceTable();
+};
+
+#endif
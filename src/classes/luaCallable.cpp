@@ -9,25 +9,43 @@
 #endif
 
 // I used "GDScriptLambdaCallable" as a template for this
-LuaCallable::LuaCallable(Ref<LuaAPI> obj, int ref, lua_State *p_state) {
+LuaCallable::LuaCallable(Ref<LuaAPI> obj, int ref, const void *p_function, lua_State *p_state) {
 	objectID = obj->get_instance_id();
 	funcRef = ref;
+	function = p_function;
 	state = p_state;
-	h = (uint32_t)hash_djb2_one_64((uint64_t)this);
+	handlerRef = obj->getErrorHandlerRef();
+	h = (uint32_t)hash_djb2_one_64((uint64_t)function, hash_djb2_one_64((uint64_t)objectID));
 }
 
 LuaCallable::~LuaCallable() {
-	luaL_unref(state, LUA_REGISTRYINDEX, funcRef);
+#ifndef LAPI_GDEXTENSION
+	LuaAPI *api = Object::cast_to<LuaAPI>(ObjectDB::get_instance(objectID));
+#else
+	// blame this on https://github.com/godotengine/godot-cpp/issues/995
+	LuaAPI *api = dynamic_cast<LuaAPI *>(ObjectDB::get_instance(objectID));
+#endif
+	// The state is already closed if the api is gone
+	if (api != nullptr) {
+		api->releaseFunctionRef(function);
+	}
 }
 
 bool LuaCallable::compare_equal(const CallableCustom *p_a, const CallableCustom *p_b) {
-	// Lua callables are only compared by reference.
-	return p_a == p_b;
+	// Both are LuaCallables since they share this compare function. Callables to the same Lua function are equal.
+	// Two states can place functions at the same address, so the owning LuaAPI is compared first.
+	const LuaCallable *a = static_cast<const LuaCallable *>(p_a);
+	const LuaCallable *b = static_cast<const LuaCallable *>(p_b);
+	return a->objectID == b->objectID && a->function == b->function;
 }
 
 bool LuaCallable::compare_less(const CallableCustom *p_a, const CallableCustom *p_b) {
-	// Lua callables are only compared by reference.
-	return p_a < p_b;
+	const LuaCallable *a = static_cast<const LuaCallable *>(p_a);
+	const LuaCallable *b = static_cast<const LuaCallable *>(p_b);
+	if (a->objectID != b->objectID) {
+		return (uint64_t)a->objectID < (uint64_t)b->objectID;
+	}
+	return a->function < b->function;
 }
 
 CallableCustom::CompareEqualFunc LuaCallable::get_compare_equal_func() const {
@@ -61,25 +79,32 @@ bool LuaCallable::is_valid() const {
 }
 
 void LuaCallable::call(const Variant **p_arguments, int p_argcount, Variant &r_return_value, LAPI_CALL_ERROR &r_call_error) const {
-	lua_pushcfunction(state, LuaState::luaErrorHandler);
-
-	// Getting the lua function via the reference stored in funcRef
-	lua_rawgeti(state, LUA_REGISTRYINDEX, funcRef);
-
-	// Push all the argument on to the stack
-	for (int i = 0; i < p_argcount; i++) {
-		LuaState::pushVariant(state, *p_arguments[i]);
-	}
-
-	// execute the function using a protected call.
-	int ret = lua_pcall(state, p_argcount, 1, -2 - p_argcount);
-	if (ret != LUA_OK) {
-		r_return_value = LuaState::handleError(state, ret);
+	// Signals can call this many times per frame, so the error handler comes from the registry instead of a new C function each call
+	int top = lua_gettop(state);
+	if (!lua_checkstack(state, p_argcount + 2)) {
+		r_return_value = LuaError::newError("Lua stack overflow while pushing the arguments.", LuaError::ERR_RUNTIME);
 	} else {
-		r_return_value = LuaState::getVariant(state, -1);
+		lua_rawgeti(state, LUA_REGISTRYINDEX, handlerRef);
+
+		// Getting the lua function via the reference stored in funcRef
+		lua_rawgeti(state, LUA_REGISTRYINDEX, funcRef);
+
+		// Push all the argument on to the stack
+		for (int i = 0; i < p_argcount; i++) {
+			LuaState::pushVariant(state, *p_arguments[i]);
+		}
+
+		// execute the function using a protected call.
+		LuaAPI::ExecutionScope scope(LuaState::getAPI(state), state);
+		int ret = lua_pcall(state, p_argcount, 1, top + 1);
+		if (ret != LUA_OK) {
+			r_return_value = LuaState::handleError(state, ret);
+		} else {
+			r_return_value = LuaState::getVariant(state, -1);
+		}
 	}
 
-	lua_pop(state, 1);
+	lua_settop(state, top);
 // TODO: Tie the error handling systems together?
 #ifndef LAPI_GDEXTENSION
 	r_call_error.error = LAPI_CALL_ERROR::CALL_OK;
@@ -90,4 +115,73 @@ void LuaCallable::call(const Variant **p_arguments, int p_argcount, Variant &r_r
 
 int LuaCallable::getFuncRef() {
 	return funcRef;
-}
\ No newline at end of file
+}
+LuaAwaitCallable::LuaAwaitCallable(LuaAPI *api, int p_threadRef, lua_State *p_thread, uint64_t p_token) {
+	objectID = api->get_instance_id();
+	threadRef = p_threadRef;
+	thread = p_thread;
+	token = p_token;
+	h = (uint32_t)hash_djb2_one_64((uint64_t)this);
+}
+
+LuaAwaitCallable::~LuaAwaitCallable() {
+	// The state is already closed if the api is gone
+	if (LuaAPI *api = getAPI(); api != nullptr) {
+		api->endAwait(thread, token);
+		api->releaseRef(threadRef);
+	}
+}
+
+LuaAPI *LuaAwaitCallable::getAPI() const {
+#ifndef LAPI_GDEXTENSION
+	return Object::cast_to<LuaAPI>(ObjectDB::get_instance(objectID));
+#else
+	// blame this on https://github.com/godotengine/godot-cpp/issues/995
+	return dynamic_cast<LuaAPI *>(ObjectDB::get_instance(objectID));
+#endif
+}
+
+// Every await is its own connection
+bool LuaAwaitCallable::compare_equal(const CallableCustom *p_a, const CallableCustom *p_b) {
+	return p_a == p_b;
+}
+
+bool LuaAwaitCallable::compare_less(const CallableCustom *p_a, const CallableCustom *p_b) {
+	return p_a < p_b;
+}
+
+CallableCustom::CompareEqualFunc LuaAwaitCallable::get_compare_equal_func() const {
+	return compare_equal;
+}
+
+CallableCustom::CompareLessFunc LuaAwaitCallable::get_compare_less_func() const {
+	return compare_less;
+}
+
+ObjectID LuaAwaitCallable::get_object() const {
+	return objectID;
+}
+
+String LuaAwaitCallable::get_as_text() const {
+	return vformat("LuaAwaitCallable 0x%X", h);
+}
+
+uint32_t LuaAwaitCallable::hash() const {
+	return h;
+}
+
+bool LuaAwaitCallable::is_valid() const {
+	return ObjectDB::get_instance(objectID);
+}
+
+void LuaAwaitCallable::call(const Variant **p_arguments, int p_argcount, Variant &r_return_value, LAPI_CALL_ERROR &r_call_error) const {
+	if (LuaAPI *api = getAPI(); api != nullptr) {
+		api->resumeAwaited(thread, token, p_arguments, p_argcount);
+	}
+
+#ifndef LAPI_GDEXTENSION
+	r_call_error.error = LAPI_CALL_ERROR::CALL_OK;
+#else
+	r_call_error.error = GDExtensionCallErrorType::GDEXTENSION_CALL_OK;
+#endif
+}
@@ -22,7 +22,7 @@ using namespace godot;
 
 class LuaCallable : public CallableCustom {
 public:
-	LuaCallable(Ref<LuaAPI> obj, int ref, lua_State *p_state);
+	LuaCallable(Ref<LuaAPI> obj, int ref, const void *p_function, lua_State *p_state);
 	virtual ~LuaCallable() override;
 
 	virtual uint32_t hash() const override;
@@ -39,7 +39,9 @@ public:
 	lua_State *getLuaState() const;
 
 private:
-	int funcRef;
+	int handlerRef; // LuaState::luaErrorHandler in the registry
+	int funcRef; // Shared with other handles to the same function, see LuaAPI::acquireFunctionRef
+	const void *function = nullptr; // Identifies the Lua function, used for hashing and comparing
 	ObjectID objectID;
 	lua_State *state = nullptr;
 	uint32_t h;
@@ -48,4 +50,32 @@ private:
 	static bool compare_less(const CallableCustom *p_a, const CallableCustom *p_b);
 };
 
+// One-shot callable connected by await(signal), resumes the awaiting thread with the signal arguments.
+class LuaAwaitCallable : public CallableCustom {
+public:
+	LuaAwaitCallable(LuaAPI *api, int threadRef, lua_State *thread, uint64_t token);
+	virtual ~LuaAwaitCallable() override;
+
+	virtual uint32_t hash() const override;
+	virtual String get_as_text() const override;
+	virtual CompareEqualFunc get_compare_equal_func() const override;
+	virtual CompareLessFunc get_compare_less_func() const override;
+
+	virtual ObjectID get_object() const override;
+
+	virtual void call(const Variant **p_argument, int p_argcount, Variant &r_return_value, LAPI_CALL_ERROR &r_call_error) const override;
+	virtual bool is_valid() const override;
+
+private:
+	ObjectID objectID;
+	int threadRef; // Keeps the thread alive while it waits
+	lua_State *thread = nullptr;
+	uint64_t token; // See LuaAPI::beginAwait
+	uint32_t h;
+
+	static bool compare_equal(const CallableCustom *p_a, const CallableCustom *p_b);
+	static bool compare_less(const CallableCustom *p_a, const CallableCustom *p_b);
+	LuaAPI *getAPI() const;
+};
+
 #endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "luaAPI.h"
 #include "luaTuple.h"
 
+#include <luaCallArgs.h>
 #include <luaState.h>
 
 #ifndef LAPI_GDEXTENSION
@@ -15,6 +16,7 @@ void LuaCallableExtra::_bind_methods() {
 	ClassDB::bind_static_method("LuaCallableExtra", D_METHOD("with_tuple", "Callable", "argc"), &LuaCallableExtra::withTuple);
 	ClassDB::bind_static_method("LuaCallableExtra", D_METHOD("with_ref", "Callable"), &LuaCallableExtra::withRef);
 	ClassDB::bind_static_method("LuaCallableExtra", D_METHOD("with_ref_and_tuple", "Callable", "argc"), &LuaCallableExtra::withRefAndTuple);
+	ClassDB::bind_static_method("LuaCallableExtra", D_METHOD("with_signature", "Callable", "argTypes", "returnType"), &LuaCallableExtra::withSignature, DEFVAL(Variant::NIL));
 
 	ClassDB::bind_method(D_METHOD("set_info", "Callable", "argc", "isTuple", "wantsRef"), &LuaCallableExtra::setInfo);
 
@@ -65,28 +67,44 @@ int LuaCallableExtra::getArgc() {
 
 // Used for the __call metamethod
 int LuaCallableExtra::call(lua_State *state) {
+	int ret = callExtra(state);
+	if (ret == LuaState::CALL_ERROR) {
+		return lua_error(state);
+	}
+	if (ret == LuaState::CALL_YIELD) {
+		return lua_yield(state, lua_gettop(state));
+	}
+	return ret;
+}
+
+// Does the work for call, see LuaState::callNative for the return value.
+int LuaCallableExtra::callExtra(lua_State *state) {
 	int l_argc = lua_gettop(state) - 1; // We subtract 1 because the LuaCallableExtra is counted
 	int noneMulty = l_argc;
 	LuaCallableExtra *func = (LuaCallableExtra *)LuaState::getVariant(state, 1).operator Object *();
 	if (func == nullptr) {
 		lua_pushstring(state, "Error during LuaCallableExtra::call func==null");
-		lua_error(state);
-		return 0;
+		return LuaState::CALL_ERROR;
+	}
+
+	if (func->hasSignature) {
+		return callWithSignature(state, func);
 	}
 
 	if (func->isTuple) {
-		noneMulty = func->argc - 1; // We subtract one because the tuple is countedA
+		noneMulty = MAX(func->argc - 1, 0); // We subtract one because the tuple is counted
 	}
 
-	Array args;
+	LuaCallArgs args(noneMulty + (func->wantsRef ? 1 : 0) + (func->isTuple ? 1 : 0));
+	int argIndex = 0;
 
 	if (func->wantsRef) {
-		args.append(Ref<LuaAPI>(LuaState::getAPI(state)));
+		args[argIndex++] = Ref<LuaAPI>(LuaState::getAPI(state));
 	}
 
 	int index = 2; // we start at 2 because the LuaCallableExtra is arg 1
 	for (int i = 0; i < noneMulty; i++) {
-		args.append(LuaState::getVariant(state, index++));
+		args[argIndex++] = LuaState::getVariant(state, index++);
 	}
 
 	if (func->isTuple) {
@@ -94,37 +112,247 @@ int LuaCallableExtra::call(lua_State *state) {
 		for (int i = noneMulty; i < l_argc; i++) {
 			tupleArgs.push_back(LuaState::getVariant(state, index++));
 		}
-		args.append(LuaTuple::fromArray(tupleArgs));
+		args[argIndex++] = LuaTuple::fromArray(tupleArgs);
+	}
+
+	Variant function = func->function;
+	return LuaState::callNative(state, function, StringName(), args);
+}
+
+// Calls a function registered with withSignature. Every argument goes through the converter picked for its declared type.
+int LuaCallableExtra::callWithSignature(lua_State *state, LuaCallableExtra *func) {
+	int argc = lua_gettop(state) - 1; // We subtract 1 because the LuaCallableExtra is counted
+	int expected = func->argSignature.size();
+	if (argc != expected) {
+		const char *problem = argc < expected ? "Too few" : "Too many";
+		lua_pushstring(state, vformat("Error calling function: %s - %s arguments, expected %d but got %d.", String(func->function.get_method()), problem, expected, argc).utf8().get_data());
+		return LuaState::CALL_ERROR;
 	}
 
-	Vector<const Variant *> mem_args;
-	mem_args.resize(args.size());
-	for (int i = 0; i < args.size(); i++) {
-		mem_args.write[i] = &args[i];
+	LuaCallArgs args(argc);
+	for (int i = 0; i < argc; i++) {
+		const ArgSignature &arg = func->argSignature[i];
+		if (!arg.convert(state, i + 2, arg.type, args[i])) {
+			String got = Variant::get_type_name(LuaState::getVariant(state, i + 2).get_type());
+			lua_pushstring(state, vformat("Error calling function: %s - Invalid type for argument %d, expected %s but is %s.", String(func->function.get_method()), i + 1, Variant::get_type_name(arg.type), got).utf8().get_data());
+			return LuaState::CALL_ERROR;
+		}
 	}
 
-	const Variant **p_args = (const Variant **)mem_args.ptr();
+	Variant function = func->function;
+	return LuaState::callNative(state, function, StringName(), args, func->returnSignature.push != nullptr ? &func->returnSignature : nullptr);
+}
 
-	Variant returned;
-#ifndef LAPI_GDEXTENSION
-	Callable::CallError error;
-	func->function.callp(p_args, args.size(), returned, error);
-	if (error.error != error.CALL_OK) {
-		Ref<LuaError> err = LuaState::handleError(func->function.get_method(), error, p_args, args.size());
-		lua_pushstring(state, err->getMessage().ascii().get_data());
-		lua_error(state);
-		return 0;
+// Argument converters used by withSignature
+
+static bool toAny(lua_State *state, int index, Variant::Type type, Variant &out) {
+	out = LuaState::getVariant(state, index);
+	return true;
+}
+
+static bool toChecked(lua_State *state, int index, Variant::Type type, Variant &out) {
+	out = LuaState::getVariant(state, index);
+	return out.get_type() == type;
+}
+
+static bool toBool(lua_State *state, int index, Variant::Type type, Variant &out) {
+	if (lua_type(state, index) != LUA_TBOOLEAN) {
+		return false;
 	}
+	out = (bool)lua_toboolean(state, index);
+	return true;
+}
+
+static bool toInt(lua_State *state, int index, Variant::Type type, Variant &out) {
+	if (lua_type(state, index) != LUA_TNUMBER) {
+		return false;
+	}
+
+#ifndef LAPI_LUAJIT
+	int isInteger = 0;
+	lua_Integer value = lua_tointegerx(state, index, &isInteger);
+	if (!isInteger) {
+		return false;
+	}
+	out = (int64_t)value;
 #else
-	returned = func->function.callv(args);
+	lua_Number value = lua_tonumber(state, index);
+	if (value != (lua_Number)(int64_t)value) {
+		return false;
+	}
+	out = (int64_t)value;
 #endif
+	return true;
+}
+
+static bool toFloat(lua_State *state, int index, Variant::Type type, Variant &out) {
+	if (lua_type(state, index) != LUA_TNUMBER) {
+		return false;
+	}
+	out = (double)lua_tonumber(state, index);
+	return true;
+}
 
-	LuaState::pushVariant(state, returned);
-	if (LuaTuple *tuple = Object::cast_to<LuaTuple>(returned.operator Object *()); tuple != nullptr) {
-		return tuple->size();
+static bool toString(lua_State *state, int index, Variant::Type type, Variant &out) {
+	if (lua_type(state, index) != LUA_TSTRING) {
+		return false;
 	}
+	out = String::utf8(lua_tostring(state, index));
+	return true;
+}
+
+// Builtin types are stored as a Variant inside userdata with the matching metatable
+static bool toUserdata(lua_State *state, int index, const char *metatable, Variant &out) {
+	Variant *ud = (Variant *)luaL_testudata(state, index, metatable);
+	if (ud == nullptr) {
+		return false;
+	}
+	out = *ud;
+	return true;
+}
+
+static bool toVector2(lua_State *state, int index, Variant::Type type, Variant &out) {
+	return toUserdata(state, index, "mt_Vector2", out);
+}
+
+static bool toVector3(lua_State *state, int index, Variant::Type type, Variant &out) {
+	return toUserdata(state, index, "mt_Vector3", out);
+}
 
-	return 1;
+static bool toColor(lua_State *state, int index, Variant::Type type, Variant &out) {
+	return toUserdata(state, index, "mt_Color", out);
+}
+
+static bool toRect2(lua_State *state, int index, Variant::Type type, Variant &out) {
+	return toUserdata(state, index, "mt_Rect2", out);
+}
+
+static bool toPlane(lua_State *state, int index, Variant::Type type, Variant &out) {
+	return toUserdata(state, index, "mt_Plane", out);
+}
+
+static bool toObject(lua_State *state, int index, Variant::Type type, Variant &out) {
+	// nil is a valid null Object
+	if (lua_isnil(state, index)) {
+		out = (Object *)nullptr;
+		return true;
+	}
+	return toUserdata(state, index, "mt_Object", out);
+}
+
+// Return converters used by withSignature
+
+static bool pushInt(lua_State *state, Variant::Type type, const Variant &value) {
+	if (value.get_type() != Variant::INT) {
+		return false;
+	}
+	lua_pushinteger(state, (int64_t)value);
+	return true;
+}
+
+static bool pushFloat(lua_State *state, Variant::Type type, const Variant &value) {
+	if (value.get_type() != Variant::FLOAT && value.get_type() != Variant::INT) {
+		return false;
+	}
+	lua_pushnumber(state, value.operator double());
+	return true;
+}
+
+static bool pushBool(lua_State *state, Variant::Type type, const Variant &value) {
+	if (value.get_type() != Variant::BOOL) {
+		return false;
+	}
+	lua_pushboolean(state, (bool)value);
+	return true;
+}
+
+static bool pushString(lua_State *state, Variant::Type type, const Variant &value) {
+	if (value.get_type() != Variant::STRING && value.get_type() != Variant::STRING_NAME) {
+		return false;
+	}
+	lua_pushstring(state, value.operator String().utf8().get_data());
+	return true;
+}
+
+static bool pushChecked(lua_State *state, Variant::Type type, const Variant &value) {
+	if (value.get_type() != type) {
+		return false;
+	}
+	LuaState::pushVariant(state, value);
+	return true;
+}
+
+// Returns the function pushing return values of the given type, TYPE_NIL leaves them to the generic pushVariant.
+static bool (*getReturnConverter(Variant::Type type))(lua_State *, Variant::Type, const Variant &) {
+	switch (type) {
+		case Variant::NIL:
+			return nullptr;
+		case Variant::INT:
+			return pushInt;
+		case Variant::FLOAT:
+			return pushFloat;
+		case Variant::BOOL:
+			return pushBool;
+		case Variant::STRING:
+			return pushString;
+		default:
+			return pushChecked;
+	}
+}
+
+Ref<LuaCallableExtra> LuaCallableExtra::withSignature(Callable func, Array argTypes, int returnType) {
+	Ref<LuaCallableExtra> toReturn;
+	toReturn.instantiate();
+	toReturn->setInfo(func, argTypes.size(), false, false);
+	toReturn->hasSignature = true;
+
+	toReturn->argSignature.resize(argTypes.size());
+	for (int i = 0; i < argTypes.size(); i++) {
+		ArgSignature &arg = toReturn->argSignature[i];
+		arg.type = (Variant::Type)(int)argTypes[i];
+		switch (arg.type) {
+			case Variant::NIL:
+				arg.convert = toAny;
+				break;
+			case Variant::BOOL:
+				arg.convert = toBool;
+				break;
+			case Variant::INT:
+				arg.convert = toInt;
+				break;
+			case Variant::FLOAT:
+				arg.convert = toFloat;
+				break;
+			case Variant::STRING:
+				arg.convert = toString;
+				break;
+			case Variant::VECTOR2:
+				arg.convert = toVector2;
+				break;
+			case Variant::VECTOR3:
+				arg.convert = toVector3;
+				break;
+			case Variant::COLOR:
+				arg.convert = toColor;
+				break;
+			case Variant::RECT2:
+				arg.convert = toRect2;
+				break;
+			case Variant::PLANE:
+				arg.convert = toPlane;
+				break;
+			case Variant::OBJECT:
+				arg.convert = toObject;
+				break;
+			default:
+				arg.convert = toChecked;
+				break;
+		}
+	}
+
+	toReturn->returnSignature.type = (Variant::Type)returnType;
+	toReturn->returnSignature.push = getReturnConverter(toReturn->returnSignature.type);
+	return toReturn;
 }
 
 Ref<LuaCallableExtra> LuaCallableExtra::withTuple(Callable func, int argc) {
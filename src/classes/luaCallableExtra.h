@@ -4,11 +4,14 @@
 #ifndef LAPI_GDEXTENSION
 #include "core/core_bind.h"
 #include "core/object/ref_counted.h"
+#include "core/templates/local_vector.h"
 #else
 #include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
 #include <godot_cpp/templates/vector.hpp>
 #endif
 
+#include <luaState.h>
 #include <lua/lua.hpp>
 
 #ifdef LAPI_GDEXTENSION
@@ -25,6 +28,7 @@ public:
 	static Ref<LuaCallableExtra> withTuple(Callable function, int argc);
 	static Ref<LuaCallableExtra> withRef(Callable function);
 	static Ref<LuaCallableExtra> withRefAndTuple(Callable function, int argc);
+	static Ref<LuaCallableExtra> withSignature(Callable function, Array argTypes, int returnType);
 
 	void setInfo(Callable function, int argc, bool isTuple, bool wantsRef);
 
@@ -45,5 +49,19 @@ private:
 	int argc = 0;
 
 	Callable function;
+
+	// Converts the Lua value at index to type, returning false if it is not of that type
+	struct ArgSignature {
+		Variant::Type type = Variant::NIL;
+		bool (*convert)(lua_State *state, int index, Variant::Type type, Variant &out) = nullptr;
+	};
+
+	// Set by withSignature, the converters are picked once there instead of on every call
+	bool hasSignature = false;
+	LocalVector<ArgSignature> argSignature;
+	LuaState::ReturnSignature returnSignature;
+
+	static int callExtra(lua_State *state);
+	static int callWithSignature(lua_State *state, LuaCallableExtra *func);
 };
 #endif
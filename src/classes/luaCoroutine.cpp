@@ -11,13 +11,16 @@
 void LuaCoroutine::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("bind", "lua"), &LuaCoroutine::bind);
 	ClassDB::bind_method(D_METHOD("set_hook", "Hook", "HookMask", "Count"), &LuaCoroutine::setHook);
+	ClassDB::bind_method(D_METHOD("set_hook_filter", "Breakpoints", "Functions"), &LuaCoroutine::setHookFilter, DEFVAL(PackedStringArray()));
 	ClassDB::bind_method(D_METHOD("resume", "Args"), &LuaCoroutine::resume);
+	ClassDB::bind_method(D_METHOD("resume_into", "Args", "Results"), &LuaCoroutine::resumeInto);
 	ClassDB::bind_method(D_METHOD("yield_await", "Args"), &LuaCoroutine::yieldAwait);
 	ClassDB::bind_method(D_METHOD("yield_state", "Args"), &LuaCoroutine::yield);
 
 	ClassDB::bind_method(D_METHOD("load_string", "Code"), &LuaCoroutine::loadString);
 	ClassDB::bind_method(D_METHOD("load_file", "FilePath"), &LuaCoroutine::loadFile);
 	ClassDB::bind_method(D_METHOD("is_done"), &LuaCoroutine::isDone);
+	ClassDB::bind_method(D_METHOD("is_awaiting"), &LuaCoroutine::isAwaiting);
 
 	ClassDB::bind_method(D_METHOD("call_function", "LuaFunctionName", "Args"), &LuaCoroutine::callFunction);
 	ClassDB::bind_method(D_METHOD("function_exists", "LuaFunctionName"), &LuaCoroutine::luaFunctionExists);
@@ -30,19 +33,35 @@ void LuaCoroutine::_bind_methods() {
 	ADD_SIGNAL(MethodInfo("coroutine_resume"));
 }
 
+LuaCoroutine::~LuaCoroutine() {
+	release();
+}
+
+// Gives the thread back to the LuaAPI, which pools it if it can be reused
+void LuaCoroutine::release() {
+	if (parent.is_valid() && tState != nullptr) {
+		parent->releaseThread(tState);
+	}
+	tState = nullptr;
+}
+
 // binds the thread to a lua object
 void LuaCoroutine::bind(Ref<LuaAPI> lua) {
+	release();
+	done = false;
+	awaiting = false;
 	parent = lua;
-	tState = lua->newThreadState();
+	tState = lua->acquireThread(get_instance_id());
 	state.setState(tState, lua.ptr(), false);
 
 	// register the yield method
 	lua_register(tState, "yield", luaYield);
 }
 
-// binds the thread to a lua object
+// binds the thread to a lua object. Use LuaAPI::getCoroutine, which anchors the thread and keeps one wrapper per thread.
 void LuaCoroutine::bindExisting(Ref<LuaAPI> lua, lua_State *L) {
 	done = false;
+	awaiting = false;
 	parent = lua;
 	this->tState = L;
 	state.setState(tState, lua.ptr(), false);
@@ -55,7 +74,12 @@ void LuaCoroutine::setHook(Callable hook, int mask, int count) {
 	return state.setHook(hook, mask, count);
 }
 
+void LuaCoroutine::setHookFilter(Dictionary breakpoints, PackedStringArray functions) {
+	return state.setHookFilter(breakpoints, functions);
+}
+
 Signal LuaCoroutine::yieldAwait(Array args) {
+	awaiting = true;
 	lua_pop(tState, 1); // Pop function off top of stack.
 	for (int i = 0; i < args.size(); i++) {
 		Ref<LuaError> err = state.pushVariant(args[i]);
@@ -147,110 +171,105 @@ Ref<LuaError> LuaCoroutine::yield(Array args) {
 	return nullptr;
 }
 
+// Runs the function awaiting coroutine_resume, if yield_await set one up. Its return value replaces args.
 #ifndef LAPI_GDEXTENSION
 
-Variant LuaCoroutine::resume(Array args) {
-	if (done) {
-		return LuaError::newError("Thread is done executing", LuaError::ERR_RUNTIME);
-	}
-
+Ref<LuaError> LuaCoroutine::runAwaitCallback(Array &args) {
 	List<Connection> resume_connections;
 	get_signal_connection_list("coroutine_resume", &resume_connections);
+	if (resume_connections.size() == 0) {
+		return nullptr;
+	}
 
-	if (resume_connections.size() > 0) {
-		if (resume_connections.size() != 1) {
-			return LuaError::newError("Cannot have more than one connection to the coroutine_resume signal", LuaError::ERR_RUNTIME);
-		}
-
-		Callable callback = resume_connections.begin()->callable;
-		if (!callback.is_valid()) {
-			return LuaError::newError("Invalid callable connected to the coroutine_resume signal", LuaError::ERR_RUNTIME);
-		}
+	if (resume_connections.size() != 1) {
+		return LuaError::newError("Cannot have more than one connection to the coroutine_resume signal", LuaError::ERR_RUNTIME);
+	}
 
-		disconnect("coroutine_resume", callback);
+	Callable callback = resume_connections.begin()->callable;
+	if (!callback.is_valid()) {
+		return LuaError::newError("Invalid callable connected to the coroutine_resume signal", LuaError::ERR_RUNTIME);
+	}
 
-		Vector<const Variant *> mem_args;
-		mem_args.resize(args.size());
-		for (int i = 0; i < args.size(); i++) {
-			mem_args.write[i] = &args[i];
-		}
+	disconnect("coroutine_resume", callback);
 
-		const Variant **p_args = (const Variant **)mem_args.ptr();
+	Vector<const Variant *> mem_args;
+	mem_args.resize(args.size());
+	for (int i = 0; i < args.size(); i++) {
+		mem_args.write[i] = &args[i];
+	}
 
-		Variant returned;
-		Callable::CallError error;
-		callback.callp(p_args, args.size(), returned, error);
-		if (error.error != Callable::CallError::CALL_OK) {
-			return state.handleError(callback.get_method(), error, p_args, args.size());
-		}
+	const Variant **p_args = (const Variant **)mem_args.ptr();
 
-		args.clear();
-		args.append(returned);
+	Variant returned;
+	Callable::CallError error;
+	callback.callp(p_args, args.size(), returned, error);
+	if (error.error != Callable::CallError::CALL_OK) {
+		return state.handleError(callback.get_method(), error, p_args, args.size());
 	}
 
-	for (int i = 0; i < args.size(); i++) {
-		Ref<LuaError> err = state.pushVariant(args[i]);
-		if (!err.is_null()) {
-			return err;
-		}
-	}
+	args.clear();
+	args.append(returned);
+	return nullptr;
+}
 
-#ifndef LAPI_LUAJIT
-	int argc = 0;
-	int ret = lua_resume(tState, nullptr, args.size(), &argc);
 #else
-	int ret = lua_resume(tState, args.size());
-	int argc = lua_gettop(tState);
-#endif
 
-	if (ret == LUA_OK) {
-		done = true; // thread is finished
-	} else if (ret != LUA_YIELD) {
-		done = true;
-		return state.handleError(ret);
+Ref<LuaError> LuaCoroutine::runAwaitCallback(Array &args) {
+	TypedArray<Dictionary> resume_connections = get_signal_connection_list("coroutine_resume");
+	if (resume_connections.size() == 0) {
+		return nullptr;
 	}
 
-	Array toReturn;
-	for (int i = 1; i <= argc; i++) {
-		toReturn.append(state.getVar(i));
+	if (resume_connections.size() != 1) {
+		return LuaError::newError("Cannot have more than one connection to the coroutine_resume signal", LuaError::ERR_RUNTIME);
 	}
 
-	return toReturn;
+	bool valid = false;
+	Callable callback = resume_connections.pop_back().get("callable", &valid);
+	if (!valid || !callback.is_valid()) {
+		return LuaError::newError("Invalid callable connected to the coroutine_resume signal", LuaError::ERR_RUNTIME);
+	}
+
+	disconnect("coroutine_resume", callback);
+
+	Variant returned = callback.callv(args);
+	args.clear();
+	args.append(returned);
+	return nullptr;
 }
 
-#else
+#endif
 
-Variant LuaCoroutine::resume(Array args) {
+// Resumes the thread, leaving the values it yielded or returned on top of its stack.
+// Returns how many there are, or -1 with r_error set.
+int LuaCoroutine::resumeThread(Array &args, Ref<LuaError> &r_error) {
 	if (done) {
-		return LuaError::newError("Thread is done executing", LuaError::ERR_RUNTIME);
+		r_error = LuaError::newError("Thread is done executing", LuaError::ERR_RUNTIME);
+		return -1;
 	}
 
-	TypedArray<Dictionary> resume_connections = get_signal_connection_list("coroutine_resume");
-	if (resume_connections.size() > 0) {
-		if (resume_connections.size() != 1) {
-			return LuaError::newError("Cannot have more than one connection to the coroutine_resume signal", LuaError::ERR_RUNTIME);
+	// Only yield_await leaves something connected, so the connection list is not queried otherwise
+	if (awaiting) {
+		awaiting = false;
+		r_error = runAwaitCallback(args);
+		if (r_error.is_valid()) {
+			return -1;
 		}
+	}
 
-		bool valid = false;
-		Callable callback = resume_connections.pop_back().get("callable", &valid);
-		if (!valid || !callback.is_valid()) {
-			return LuaError::newError("Invalid callable connected to the coroutine_resume signal", LuaError::ERR_RUNTIME);
+	// Checked before anything is pushed, pushVariant raises a LuaError and the thread is not running to catch it
+	for (int i = 0; i < args.size(); i++) {
+		r_error = LuaState::checkPushable(args[i]);
+		if (r_error.is_valid()) {
+			return -1;
 		}
-
-		disconnect("coroutine_resume", callback);
-
-		Variant returned = callback.callv(args);
-		args.clear();
-		args.append(returned);
 	}
 
 	for (int i = 0; i < args.size(); i++) {
-		Ref<LuaError> err = state.pushVariant(args[i]);
-		if (!err.is_null()) {
-			return err;
-		}
+		state.pushVariant(args[i]);
 	}
 
+	LuaAPI::ExecutionScope scope(parent.ptr(), tState);
 #ifndef LAPI_LUAJIT
 	int argc = 0;
 	int ret = lua_resume(tState, nullptr, args.size(), &argc);
@@ -259,27 +278,105 @@ Variant LuaCoroutine::resume(Array args) {
 	int argc = lua_gettop(tState);
 #endif
 
+	// Still resumable, the next resume gets a fresh limit
+	if (ret == LUA_YIELD && parent->executionLimitYielded()) {
+		lua_pop(tState, argc);
+		String reason = parent->executionInterrupted() ? "Interrupted" : "Execution limit exceeded";
+		r_error = LuaError::newError(reason + ", the coroutine yielded.", LuaError::ERR_EXECUTION_LIMIT);
+		return -1;
+	}
+
 	if (ret == LUA_OK) {
 		done = true; // thread is finished
 	} else if (ret != LUA_YIELD) {
 		done = true;
-		return state.handleError(ret);
+		r_error = state.handleError(ret);
+		return -1;
+	} else if (LuaState::isAwaitYield(tState, argc)) {
+		// Waiting on a signal, which resumes it. The caller sees an empty yield.
+		lua_pop(tState, 1);
+		return 0;
+	}
+
+	return argc;
+}
+
+// Called by LuaAPI when the signal the thread awaits fires. Errors are printed since nothing called into the coroutine.
+void LuaCoroutine::resumeAwaited(const Variant **args, int argc) {
+	Array resumeArgs;
+	resumeArgs.resize(argc);
+	for (int i = 0; i < argc; i++) {
+		resumeArgs[i] = *args[i];
+	}
+
+	Ref<LuaError> err;
+	int count = resumeThread(resumeArgs, err);
+	if (count < 0) {
+		print_error(err->getMessage());
+		return;
+	}
+
+	lua_pop(tState, count);
+}
+
+Variant LuaCoroutine::resume(Array args) {
+	if (isAwaiting()) {
+		return LuaError::newError("Coroutine is awaiting a signal", LuaError::ERR_RUNTIME);
+	}
+
+	Ref<LuaError> err;
+	int count = resumeThread(args, err);
+	if (count < 0) {
+		return err;
 	}
 
 	Array toReturn;
-	for (int i = 1; i <= argc; i++) {
-		toReturn.append(state.getVar(i));
+	toReturn.resize(count);
+	int base = lua_gettop(tState) - count + 1;
+	for (int i = 0; i < count; i++) {
+		toReturn[i] = state.getVar(base + i);
 	}
 
+	// The values are copied out, the next resume pushes its own
+	lua_settop(tState, base - 1);
 	return toReturn;
 }
 
-#endif
+// Same as resume, but the results are written into results, which is resized to fit them.
+// Reusing the same array every frame avoids allocating a new one per resume.
+Ref<LuaError> LuaCoroutine::resumeInto(Array args, Array results) {
+	if (isAwaiting()) {
+		return LuaError::newError("Coroutine is awaiting a signal", LuaError::ERR_RUNTIME);
+	}
+
+	Ref<LuaError> err;
+	int count = resumeThread(args, err);
+	if (count < 0) {
+		return err;
+	}
+
+	if (results.size() != count) {
+		results.resize(count);
+	}
+
+	int base = lua_gettop(tState) - count + 1;
+	for (int i = 0; i < count; i++) {
+		results[i] = state.getVar(base + i);
+	}
+
+	lua_settop(tState, base - 1);
+	return nullptr;
+}
 
 bool LuaCoroutine::isDone() {
 	return done;
 }
 
+// True while the thread is suspended in await(signal)
+bool LuaCoroutine::isAwaiting() {
+	return parent.is_valid() && tState != nullptr && parent->isAwaiting(tState);
+}
+
 int LuaCoroutine::luaYield(lua_State *state) {
 	int argc = lua_gettop(state);
 	return lua_yield(state, argc);
@@ -26,9 +26,12 @@ protected:
 	static void _bind_methods();
 
 public:
+	~LuaCoroutine();
+
 	void bind(Ref<LuaAPI> lua);
 	void bindExisting(Ref<LuaAPI> lua, lua_State *L);
 	void setHook(Callable hook, int mask, int count);
+	void setHookFilter(Dictionary breakpoints, PackedStringArray functions);
 
 	Signal yieldAwait(Array args);
 
@@ -43,10 +46,14 @@ public:
 	Ref<LuaError> yield(Array args);
 
 	Variant resume(Array args);
+	Ref<LuaError> resumeInto(Array args, Array results);
 	Variant pullVariant(String name);
 	Variant callFunction(String functionName, Array args);
 
 	bool isDone();
+	bool isAwaiting();
+
+	void resumeAwaited(const Variant **args, int argc);
 
 	static int luaYield(lua_State *state);
 
@@ -57,8 +64,13 @@ public:
 private:
 	LuaState state;
 	Ref<LuaAPI> parent;
-	lua_State *tState;
-	bool done;
+	lua_State *tState = nullptr;
+	bool done = false;
+	bool awaiting = false; // Set by yield_await, the next resume runs the awaiting function first
+
+	void release();
+	Ref<LuaError> runAwaitCallback(Array &args);
+	int resumeThread(Array &args, Ref<LuaError> &r_error);
 };
 
 #endif
@@ -18,6 +18,7 @@ void LuaError::_bind_methods() {
 	BIND_ENUM_CONSTANT(ERR_MEMORY);
 	BIND_ENUM_CONSTANT(ERR_ERR);
 	BIND_ENUM_CONSTANT(ERR_FILE);
+	BIND_ENUM_CONSTANT(ERR_EXECUTION_LIMIT);
 }
 
 // Create a new error
@@ -43,12 +44,44 @@ bool LuaError::operator==(const LuaError err) {
 
 void LuaError::setMessage(String msg) {
 	errMsg = msg;
+	trace.clear();
 }
 
 String LuaError::getMessage() const {
+	if (trace.is_empty()) {
+		return errMsg;
+	}
+
+	// Same layout as luaL_traceback
+	errMsg += "\nstack traceback:";
+	for (const TraceFrame &frame : trace) {
+		errMsg += vformat("\n\t%s:", String::utf8(frame.source));
+		if (frame.line > 0) {
+			errMsg += vformat("%d:", frame.line);
+		}
+
+		if (frame.named) {
+			errMsg += vformat(" in function '%s'", String::utf8(frame.name));
+		} else if (frame.what == 'm') {
+			errMsg += " in main chunk";
+		} else if (frame.what == 'C') {
+			errMsg += " in ?";
+		} else {
+			errMsg += vformat(" in function <%s:%d>", String::utf8(frame.source), frame.lineDefined);
+		}
+	}
+	errMsg += "\n";
+
+	trace.clear();
 	return errMsg;
 }
 
+// Takes the frames and leaves frames empty. The buffer is shared and then released, so no frame is copied.
+void LuaError::setTrace(Vector<TraceFrame> &frames) {
+	trace = frames;
+	frames.clear();
+}
+
 void LuaError::setType(ErrorType type) {
 	errType = type;
 }
@@ -4,8 +4,10 @@
 #ifndef LAPI_GDEXTENSION
 #include "core/core_bind.h"
 #include "core/object/ref_counted.h"
+#include "core/templates/vector.h"
 #else
 #include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/templates/vector.hpp>
 #endif
 
 #include <lua/lua.hpp>
@@ -28,9 +30,20 @@ public:
 		ERR_MEMORY = LUA_ERRMEM,
 		ERR_ERR = LUA_ERRERR,
 		ERR_FILE = LUA_ERRFILE,
+		ERR_EXECUTION_LIMIT = LUA_ERRFILE + 1, // Raised by LuaAPI.set_execution_limit
 	};
 	static Ref<LuaError> newError(String msg, ErrorType type);
 
+	// Raw stack frame captured by the error handler in lazy traceback mode. Strings are copied since Lua may collect them.
+	struct TraceFrame {
+		char source[LUA_IDSIZE];
+		char name[64];
+		int line = -1;
+		int lineDefined = 0;
+		char what = 0; // First character of lua_Debug::what
+		bool named = false;
+	};
+
 	void setInfo(String msg, ErrorType type);
 	bool operator==(const ErrorType type);
 	bool operator==(const LuaError err);
@@ -40,9 +53,13 @@ public:
 	void setType(ErrorType type);
 	ErrorType getType() const;
 
+	void setTrace(Vector<TraceFrame> &frames);
+
 private:
 	ErrorType errType;
-	String errMsg;
+	// Formatting the traceback is left to the first getMessage call
+	mutable String errMsg;
+	mutable Vector<TraceFrame> trace;
 };
 
 VARIANT_ENUM_CAST(LuaError::ErrorType)
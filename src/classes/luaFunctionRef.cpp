@@ -1,18 +1,41 @@
 #include "luaFunctionRef.h"
 
+#include <classes/luaAPI.h>
 #include <luaState.h>
 
 void LuaFunctionRef::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("invoke", "args"), &LuaFunctionRef::invoke);
+	ClassDB::bind_method(D_METHOD("invoke_into", "args", "results"), &LuaFunctionRef::invokeInto);
+
+	{
+		MethodInfo mi;
+		mi.name = "invoke_direct";
+		ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "invoke_direct", &LuaFunctionRef::invokeDirect, mi);
+	}
 }
 
 LuaFunctionRef::LuaFunctionRef() {
 	L = nullptr;
 	ref = LUA_NOREF;
+	handlerRef = LUA_NOREF;
 }
 
 LuaFunctionRef::~LuaFunctionRef() {
-	luaL_unref(L, LUA_REGISTRYINDEX, ref);
+	if (function == nullptr) {
+		luaL_unref(L, LUA_REGISTRYINDEX, ref);
+		return;
+	}
+
+#ifndef LAPI_GDEXTENSION
+	LuaAPI *api = Object::cast_to<LuaAPI>(ObjectDB::get_instance(apiID));
+#else
+	// blame this on https://github.com/godotengine/godot-cpp/issues/995
+	LuaAPI *api = dynamic_cast<LuaAPI *>(ObjectDB::get_instance(apiID));
+#endif
+	// The state is already closed if the api is gone
+	if (api != nullptr) {
+		api->releaseFunctionRef(function, get_instance_id());
+	}
 }
 
 void LuaFunctionRef::setLuaState(lua_State *state) {
@@ -23,24 +46,89 @@ void LuaFunctionRef::setRef(int ref) {
 	this->ref = ref;
 }
 
-Variant LuaFunctionRef::invoke(Array args) {
-	lua_pushcfunction(L, LuaState::luaErrorHandler);
-	lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+void LuaFunctionRef::setErrorHandlerRef(int ref) {
+	handlerRef = ref;
+}
 
+void LuaFunctionRef::setShared(ObjectID api, const void *function) {
+	apiID = api;
+	this->function = function;
+}
+
+Variant LuaFunctionRef::invoke(Array args) {
+	Vector<const Variant *> argPtrs;
+	argPtrs.resize(args.size());
 	for (int i = 0; i < args.size(); i++) {
-		Variant arg = args[i];
-		LuaState::pushVariant(L, arg);
+		argPtrs.write[i] = &args[i];
 	}
 
-	int err = lua_pcall(L, args.size(), 1, -2 - args.size());
+	return invokep((const Variant **)argPtrs.ptr(), args.size());
+}
+
+Variant LuaFunctionRef::invokep(const Variant **args, int argc) {
+	LuaAPI::ExecutionScope scope(LuaState::getAPI(L), L);
+	int top = lua_gettop(L);
+	int err = pcall(args, argc, 1);
 	Variant ret;
 	if (err) {
-		ret = LuaState::handleError(L, ret);
+		ret = LuaState::handleError(L, err);
 	} else {
 		ret = LuaState::getVariant(L, -1);
 	}
 
-	lua_pop(L, 1);
+	// Drops the result and the error handler
+	lua_settop(L, top);
 
 	return ret;
-}
\ No newline at end of file
+}
+
+// Keeps every value the function returns, see LuaState::callFunctionInto
+Ref<LuaError> LuaFunctionRef::invokeInto(Array args, Array results) {
+	Vector<const Variant *> argPtrs;
+	argPtrs.resize(args.size());
+	for (int i = 0; i < args.size(); i++) {
+		argPtrs.write[i] = &args[i];
+	}
+
+	LuaAPI::ExecutionScope scope(LuaState::getAPI(L), L);
+	int top = lua_gettop(L);
+	int err = pcall((const Variant **)argPtrs.ptr(), args.size(), LUA_MULTRET);
+	if (err) {
+		Ref<LuaError> ret = LuaState::handleError(L, err);
+		lua_settop(L, top);
+		return ret;
+	}
+
+	LuaState::readResults(L, top + 2, results);
+	lua_settop(L, top);
+	return nullptr;
+}
+
+// Pushes the error handler and calls the function. The handler stays on the stack below the results.
+int LuaFunctionRef::pcall(const Variant **args, int argc, int nresults) {
+	int handlerIndex = lua_gettop(L) + 1;
+	if (handlerRef != LUA_NOREF) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, handlerRef);
+	} else {
+		lua_pushcfunction(L, LuaState::luaErrorHandler);
+	}
+	lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+
+	for (int i = 0; i < argc; i++) {
+		LuaState::pushVariant(L, *args[i]);
+	}
+
+	return lua_pcall(L, argc, nresults, handlerIndex);
+}
+
+#ifndef LAPI_GDEXTENSION
+Variant LuaFunctionRef::invokeDirect(const Variant **args, int argc, Callable::CallError &error) {
+	error.error = Callable::CallError::CALL_OK;
+	return invokep(args, argc);
+}
+#else
+Variant LuaFunctionRef::invokeDirect(const Variant **args, GDExtensionInt argc, GDExtensionCallError &error) {
+	error.error = GDEXTENSION_CALL_OK;
+	return invokep(args, argc);
+}
+#endif
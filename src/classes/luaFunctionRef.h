@@ -8,6 +8,7 @@
 #include <godot_cpp/classes/ref.hpp>
 #endif
 
+#include <classes/luaError.h>
 #include <lua/lua.hpp>
 
 #ifdef LAPI_GDEXTENSION
@@ -26,8 +27,18 @@ public:
 
 	void setLuaState(lua_State *state);
 	void setRef(int ref);
+	void setErrorHandlerRef(int ref);
+	void setShared(ObjectID api, const void *function);
 
 	Variant invoke(Array args);
+	Variant invokep(const Variant **args, int argc);
+	Ref<LuaError> invokeInto(Array args, Array results);
+
+#ifndef LAPI_GDEXTENSION
+	Variant invokeDirect(const Variant **args, int argc, Callable::CallError &error);
+#else
+	Variant invokeDirect(const Variant **args, GDExtensionInt argc, GDExtensionCallError &error);
+#endif
 
 	inline int getRef() const { return ref; }
 	inline lua_State *getLuaState() const { return L; }
@@ -35,6 +46,13 @@ public:
 private:
 	lua_State *L;
 	int ref;
+	int handlerRef; // Not owned, see LuaState::getFunctionHandle
+
+	// Set when ref is shared through LuaAPI::acquireFunctionRef
+	ObjectID apiID;
+	const void *function = nullptr;
+
+	int pcall(const Variant **args, int argc, int nresults);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,223 @@
+#include "luaJob.h"
+
+#include <classes/luaAPI.h>
+#include <luaState.h>
+#include <util.h>
+
+void LuaJob::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("step"), &LuaJob::step);
+	ClassDB::bind_method(D_METHOD("cancel"), &LuaJob::cancel);
+
+	ClassDB::bind_method(D_METHOD("get_status"), &LuaJob::getStatus);
+	ClassDB::bind_method(D_METHOD("is_done"), &LuaJob::isDone);
+	ClassDB::bind_method(D_METHOD("get_results"), &LuaJob::getResults);
+	ClassDB::bind_method(D_METHOD("get_error"), &LuaJob::getError);
+	ClassDB::bind_method(D_METHOD("get_step_count"), &LuaJob::getStepCount);
+
+	ClassDB::bind_method(D_METHOD("set_budget_usec", "value"), &LuaJob::setBudgetUsec);
+	ClassDB::bind_method(D_METHOD("get_budget_usec"), &LuaJob::getBudgetUsec);
+
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "budget_usec"), "set_budget_usec", "get_budget_usec");
+
+	ADD_SIGNAL(MethodInfo("finished", PropertyInfo(Variant::ARRAY, "results")));
+	ADD_SIGNAL(MethodInfo("failed", PropertyInfo(Variant::OBJECT, "error", PROPERTY_HINT_RESOURCE_TYPE, "LuaError")));
+
+	BIND_ENUM_CONSTANT(STATUS_RUNNING);
+	BIND_ENUM_CONSTANT(STATUS_AWAITING);
+	BIND_ENUM_CONSTANT(STATUS_FINISHED);
+	BIND_ENUM_CONSTANT(STATUS_FAILED);
+	BIND_ENUM_CONSTANT(STATUS_CANCELLED);
+}
+
+LuaJob::~LuaJob() {
+	if (parent.is_valid() && threadRef != LUA_NOREF) {
+		parent->releaseRef(threadRef);
+	}
+}
+
+// Moves the function on top of the main stack into a new thread. Use LuaAPI.do_string_job or LuaAPI.call_function_job.
+Ref<LuaError> LuaJob::start(Ref<LuaAPI> lua, Array args) {
+	if (parent.is_valid()) {
+		return LuaError::newError("LuaJob was already started.", LuaError::ERR_RUNTIME);
+	}
+
+	parent = lua;
+	lua_State *L = lua->getState();
+
+	// The registry ref keeps the thread alive, nothing is left on the main stack
+	thread = lua_newthread(L);
+	threadRef = luaL_ref(L, LUA_REGISTRYINDEX);
+	lua_xmove(L, thread, 1);
+
+	status = STATUS_RUNNING;
+	resumeArgs = args;
+	return nullptr;
+}
+
+// Runs the job until it finishes or budget_usec is spent. Returns false once it is done.
+bool LuaJob::step() {
+	ERR_FAIL_COND_V_MSG(stepping, true, "LuaJob.step cannot be called from the job itself.");
+	if (status != STATUS_RUNNING) {
+		return !isDone();
+	}
+
+	// A finished or failed signal may drop the last reference to the job
+	Ref<LuaJob> self(this);
+
+	Array args = resumeArgs;
+	resumeArgs = Array();
+	// The thread is not running, so values pushVariant would fail on or raise are passed as nil instead
+	int top = lua_gettop(thread);
+	for (int i = 0; i < args.size(); i++) {
+		if (LuaState::checkPushable(args[i]).is_valid()) {
+			lua_pushnil(thread);
+		} else {
+			LuaState::pushVariant(thread, args[i]);
+		}
+	}
+	int nargs = lua_gettop(thread) - top;
+
+	// LuaState::luaHook checks shouldPreempt on count events while this is the running job
+	LuaJob *previousJob = parent->swapRunningJob(this);
+	parent->refreshHook(thread);
+
+	stepping = true;
+	steps++;
+	deadline = get_ticks_usec() + MAX(budgetUsec, 0);
+	int ret;
+	int nresults;
+	{
+		LuaAPI::ExecutionScope scope(parent.ptr(), thread);
+#ifndef LAPI_LUAJIT
+		nresults = 0;
+		ret = lua_resume(thread, nullptr, nargs, &nresults);
+#else
+		ret = lua_resume(thread, nargs);
+		nresults = lua_gettop(thread);
+#endif
+		if (ret != LUA_OK && ret != LUA_YIELD) {
+			// Typed while the scope still knows whether the execution limit raised it
+			error = LuaState::handleError(thread, ret);
+		}
+	}
+	stepping = false;
+
+	parent->swapRunningJob(previousJob);
+	parent->refreshHook(thread);
+
+	if (cancelRequested) {
+		finish(STATUS_CANCELLED);
+		return false;
+	}
+
+	if (ret == LUA_YIELD) {
+		if (LuaState::isAwaitYield(thread, nresults)) {
+			status = STATUS_AWAITING;
+			parent->setAwaitOwner(thread, this, &LuaJob::resumeAwaitedJob, 0);
+		}
+		// Preempted by the hook, or the script yielded itself. Either way it goes on with the next step.
+		lua_pop(thread, nresults);
+		return true;
+	}
+
+	if (ret != LUA_OK) {
+		finish(STATUS_FAILED);
+		emit_signal("failed", error);
+		return false;
+	}
+
+	results.resize(nresults);
+	int base = lua_gettop(thread) - nresults + 1;
+	for (int i = 0; i < nresults; i++) {
+		results[i] = LuaState::getVariant(thread, base + i);
+	}
+	finish(STATUS_FINISHED);
+	emit_signal("finished", results);
+	return false;
+}
+
+// Stops the job without resuming it again. Called from the job itself, it stops once the current step yields.
+void LuaJob::cancel() {
+	if (stepping) {
+		cancelRequested = true;
+		return;
+	}
+
+	if (!isDone()) {
+		finish(STATUS_CANCELLED);
+	}
+}
+
+LuaJob::Status LuaJob::getStatus() const {
+	return status;
+}
+
+bool LuaJob::isDone() const {
+	return status != STATUS_RUNNING && status != STATUS_AWAITING;
+}
+
+Array LuaJob::getResults() const {
+	return results;
+}
+
+Ref<LuaError> LuaJob::getError() const {
+	return error;
+}
+
+int LuaJob::getStepCount() const {
+	return steps;
+}
+
+void LuaJob::setBudgetUsec(int value) {
+	budgetUsec = value;
+}
+
+int LuaJob::getBudgetUsec() const {
+	return budgetUsec;
+}
+
+lua_State *LuaJob::getThread() const {
+	return thread;
+}
+
+void LuaJob::finish(Status newStatus) {
+	status = newStatus;
+	resumeArgs = Array();
+	if (threadRef != LUA_NOREF) {
+		parent->releaseRef(threadRef);
+	}
+	threadRef = LUA_NOREF;
+	thread = nullptr;
+}
+
+// True once the budget is spent and the job can be yielded. Checked by LuaState::luaHook every LuaAPI::CHECK_INSTRUCTIONS instructions.
+bool LuaJob::shouldPreempt(lua_State *state) const {
+	// Coroutines created by the job inherit the hook, but only the job's own thread yields back to step
+	if (state != thread) {
+		return false;
+	}
+
+	// Inside a C call that can not be continued, such as a table.sort comparator, the next check gets another chance
+	return get_ticks_usec() >= deadline && lua_isyieldable(state);
+}
+
+// The signal the job awaited fired, await returns its arguments on the next step
+void LuaJob::resumeAwaitedJob(Object *owner, lua_State *thread, int64_t data, const Variant **args, int argc) {
+#ifndef LAPI_GDEXTENSION
+	LuaJob *job = Object::cast_to<LuaJob>(owner);
+#else
+	// blame this on https://github.com/godotengine/godot-cpp/issues/995
+	LuaJob *job = dynamic_cast<LuaJob *>(owner);
+#endif
+	if (job == nullptr || job->status != STATUS_AWAITING) {
+		return;
+	}
+
+	Array resumeArgs;
+	resumeArgs.resize(argc);
+	for (int i = 0; i < argc; i++) {
+		resumeArgs[i] = *args[i];
+	}
+	job->resumeArgs = resumeArgs;
+	job->status = STATUS_RUNNING;
+}
@@ -0,0 +1,79 @@
+#ifndef LUAJOB_H
+#define LUAJOB_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/object/ref_counted.h"
+#else
+#include <godot_cpp/classes/ref.hpp>
+#endif
+
+#include "luaError.h"
+
+#include <lua/lua.hpp>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+class LuaAPI;
+
+// A chunk or function run a slice at a time. Each step resumes it until the budget is spent, a count hook then yields it
+// at the next safe point so long scripts spread over several frames without yielding themselves.
+class LuaJob : public RefCounted {
+	GDCLASS(LuaJob, RefCounted);
+
+protected:
+	static void _bind_methods();
+
+public:
+	enum Status {
+		STATUS_RUNNING,
+		STATUS_AWAITING, // Suspended in await(signal), the signal makes it running again
+		STATUS_FINISHED,
+		STATUS_FAILED,
+		STATUS_CANCELLED,
+	};
+
+	~LuaJob();
+
+	Ref<LuaError> start(Ref<LuaAPI> lua, Array args);
+
+	bool step();
+	void cancel();
+
+	Status getStatus() const;
+	bool isDone() const;
+	Array getResults() const;
+	Ref<LuaError> getError() const;
+	int getStepCount() const;
+
+	void setBudgetUsec(int value);
+	int getBudgetUsec() const;
+
+	lua_State *getThread() const;
+	bool shouldPreempt(lua_State *state) const;
+
+private:
+	Ref<LuaAPI> parent;
+	lua_State *thread = nullptr;
+	int threadRef = LUA_NOREF;
+
+	Status status = STATUS_CANCELLED;
+	Array resumeArgs;
+	Array results;
+	Ref<LuaError> error;
+
+	int budgetUsec = 2000;
+	uint64_t deadline = 0;
+	int steps = 0;
+	bool stepping = false;
+	bool cancelRequested = false;
+
+	void finish(Status newStatus);
+
+	static void resumeAwaitedJob(Object *owner, lua_State *thread, int64_t data, const Variant **args, int argc);
+};
+
+VARIANT_ENUM_CAST(LuaJob::Status)
+
+#endif
@@ -1,5 +1,11 @@
 #include "luaObjectMetatable.h"
 
+#ifndef LAPI_GDEXTENSION
+#include "core/io/image.h"
+#else
+#include <godot_cpp/classes/image.hpp>
+#endif
+
 #ifdef LAPI_GDEXTENSION
 #define GDVIRTUAL_BIND(m, ...) BIND_VIRTUAL_METHOD(LuaObjectMetatable, m);
 #define VIRTUAL_CALL(m, r, ...) r = call(#m, __VA_ARGS__);
@@ -32,6 +38,7 @@ void LuaObjectMetatable::_bind_methods() {
 	GDVIRTUAL_BIND(__eq, "obj", "lua", "other");
 	GDVIRTUAL_BIND(__lt, "obj", "lua", "other");
 	GDVIRTUAL_BIND(__le, "obj", "lua", "other");
+	GDVIRTUAL_BIND(__external_size, "obj", "lua");
 }
 
 Variant LuaObjectMetatable::__index(Object *obj, Ref<LuaAPI> api, Variant index) {
@@ -178,6 +185,12 @@ bool LuaObjectMetatable::__le(Object *obj, Ref<LuaAPI> api, Variant other) {
 	return ret;
 }
 
+int64_t LuaObjectMetatable::__external_size(Object *obj, Ref<LuaAPI> api) {
+	int64_t ret = 0;
+	VIRTUAL_CALL(__external_size, ret, obj, api);
+	return ret;
+}
+
 // Default object metatable
 
 void LuaDefaultObjectMetatable::_bind_methods() {
@@ -194,17 +207,22 @@ bool LuaDefaultObjectMetatable::getPermissive() const {
 	return permissive;
 }
 
-Variant LuaDefaultObjectMetatable::__index(Object *obj, Ref<LuaAPI> api, Variant index) {
-	if (obj->has_method("__index")) {
-		return obj->call("__index", api, index);
-	}
-
+// Checks the field against the objects lua_fields, which is a blacklist when permissive and a whitelist otherwise.
+bool LuaDefaultObjectMetatable::isFieldAllowed(Object *obj, const String &field) {
 	Array fields = Array();
 	if (obj->has_method("lua_fields")) {
 		fields = obj->call("lua_fields");
 	}
 
-	if ((!permissive && fields.has((String)index)) || (permissive && !fields.has((String)index))) {
+	return (!permissive && fields.has(field)) || (permissive && !fields.has(field));
+}
+
+Variant LuaDefaultObjectMetatable::__index(Object *obj, Ref<LuaAPI> api, Variant index) {
+	if (obj->has_method("__index")) {
+		return obj->call("__index", api, index);
+	}
+
+	if (isFieldAllowed(obj, index)) {
 		return obj->get((String)index);
 	}
 
@@ -223,12 +241,7 @@ Ref<LuaError> LuaDefaultObjectMetatable::__newindex(Object *obj, Ref<LuaAPI> api
 		}
 	}
 
-	Array fields = Array();
-	if (obj->has_method("lua_fields")) {
-		fields = obj->call("lua_fields");
-	}
-
-	if ((!permissive && fields.has(index)) || (permissive && !fields.has(index))) {
+	if (isFieldAllowed(obj, index)) {
 		obj->set(index, value);
 		return nullptr;
 	}
@@ -418,3 +431,16 @@ bool LuaDefaultObjectMetatable::__le(Object *obj, Ref<LuaAPI> api, Variant other
 
 	return Variant();
 }
+
+int64_t LuaDefaultObjectMetatable::__external_size(Object *obj, Ref<LuaAPI> api) {
+	if (obj->has_method("__external_size")) {
+		return obj->call("__external_size", api);
+	}
+
+	// Images are the common case of a tiny handle keeping a lot of memory alive.
+	if (Image *image = Object::cast_to<Image>(obj); image != nullptr) {
+		return image->get_data().size();
+	}
+
+	return 0;
+}
@@ -47,6 +47,7 @@ protected:
 	GDVIRTUAL3R(bool, __eq, Object *, Ref<LuaAPI>, Variant);
 	GDVIRTUAL3R(bool, __lt, Object *, Ref<LuaAPI>, Variant);
 	GDVIRTUAL3R(bool, __le, Object *, Ref<LuaAPI>, Variant);
+	GDVIRTUAL2R(int64_t, __external_size, Object *, Ref<LuaAPI>);
 #endif
 
 public:
@@ -74,6 +75,7 @@ public:
 	virtual bool __eq(Object *obj, Ref<LuaAPI> api, Variant other);
 	virtual bool __lt(Object *obj, Ref<LuaAPI> api, Variant other);
 	virtual bool __le(Object *obj, Ref<LuaAPI> api, Variant other);
+	virtual int64_t __external_size(Object *obj, Ref<LuaAPI> api);
 
 private:
 };
@@ -111,10 +113,13 @@ public:
 	bool __eq(Object *obj, Ref<LuaAPI> api, Variant other) override;
 	bool __lt(Object *obj, Ref<LuaAPI> api, Variant other) override;
 	bool __le(Object *obj, Ref<LuaAPI> api, Variant other) override;
+	int64_t __external_size(Object *obj, Ref<LuaAPI> api) override;
 
 	void setPermissive(bool permissive);
 	bool getPermissive() const;
 
+	bool isFieldAllowed(Object *obj, const String &field);
+
 private:
 	bool permissive = true;
 };
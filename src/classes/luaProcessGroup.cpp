@@ -0,0 +1,322 @@
+#include "luaProcessGroup.h"
+#include "luaTuple.h"
+
+#include <classes/luaAPI.h>
+#include <luaState.h>
+#include <util.h>
+
+void LuaProcessGroup::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("bind", "lua"), &LuaProcessGroup::bind);
+	ClassDB::bind_method(D_METHOD("add", "Function", "Self"), &LuaProcessGroup::add, DEFVAL(Variant()));
+	ClassDB::bind_method(D_METHOD("add_method", "TableName", "MethodName"), &LuaProcessGroup::addMethod);
+	ClassDB::bind_method(D_METHOD("remove", "id"), &LuaProcessGroup::remove);
+	ClassDB::bind_method(D_METHOD("has", "id"), &LuaProcessGroup::has);
+	ClassDB::bind_method(D_METHOD("clear"), &LuaProcessGroup::clear);
+
+	ClassDB::bind_method(D_METHOD("tick", "delta"), &LuaProcessGroup::tick);
+
+	ClassDB::bind_method(D_METHOD("set_profiling", "value"), &LuaProcessGroup::setProfiling);
+	ClassDB::bind_method(D_METHOD("get_profiling"), &LuaProcessGroup::getProfiling);
+
+	ClassDB::bind_method(D_METHOD("get_count"), &LuaProcessGroup::getCount);
+	ClassDB::bind_method(D_METHOD("get_ids"), &LuaProcessGroup::getIds);
+	ClassDB::bind_method(D_METHOD("get_entry_time_usec", "id"), &LuaProcessGroup::getEntryTimeUsec);
+	ClassDB::bind_method(D_METHOD("get_tick_time_usec"), &LuaProcessGroup::getTickTimeUsec);
+
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "profiling"), "set_profiling", "get_profiling");
+
+	ADD_SIGNAL(MethodInfo("entry_failed", PropertyInfo(Variant::INT, "id"), PropertyInfo(Variant::OBJECT, "error", PROPERTY_HINT_RESOURCE_TYPE, "LuaError")));
+}
+
+LuaProcessGroup::~LuaProcessGroup() {
+	if (L == nullptr) {
+		return;
+	}
+
+	for (const Entry &entry : entries) {
+		if (entry.alive) {
+			luaL_unref(L, LUA_REGISTRYINDEX, entry.funcRef);
+			luaL_unref(L, LUA_REGISTRYINDEX, entry.selfRef);
+		}
+	}
+}
+
+void LuaProcessGroup::bind(Ref<LuaAPI> lua) {
+	ERR_FAIL_COND_MSG(count > 0, "Cannot rebind a LuaProcessGroup with entries.");
+	parent = lua;
+	L = lua->getState();
+}
+
+// Adds an entry called as function(self, delta) every tick, or function(delta) without a self.
+// The function is a global function name, a LuaCallable or a LuaFunctionRef. Returns the entry id or a LuaError.
+Variant LuaProcessGroup::add(Variant function, Variant self) {
+	if (L == nullptr) {
+		return LuaError::newError("LuaProcessGroup is not bound to a LuaAPI.", LuaError::ERR_RUNTIME);
+	}
+
+	bool named = function.get_type() == Variant::STRING || function.get_type() == Variant::STRING_NAME;
+
+	// No Lua call is running here, so a LuaError reaching pushVariant would raise unprotected
+	Ref<LuaError> err = named ? Ref<LuaError>() : LuaState::checkPushable(function);
+	if (err.is_null()) {
+		err = LuaState::checkPushable(self);
+	}
+	if (err.is_valid()) {
+		return LuaError::newError(vformat("Entry can not be passed to Lua: %s", err->getMessage()), LuaError::ERR_TYPE);
+	}
+
+	// addEntry refs exactly one self value
+#ifndef LAPI_GDEXTENSION
+	if (Object::cast_to<LuaTuple>(self.operator Object *()) != nullptr) {
+#else
+	// blame this on https://github.com/godotengine/godot-cpp/issues/995
+	if (dynamic_cast<LuaTuple *>(self.operator Object *()) != nullptr) {
+#endif
+		return LuaError::newError("Self can not be a LuaTuple.", LuaError::ERR_TYPE);
+	}
+
+	int top = lua_gettop(L);
+	if (named) {
+		if (!parent->pushGlobalFunction(function)) {
+			return LuaError::newError(vformat("Function \"%s\" does not exist.", function), LuaError::ERR_RUNTIME);
+		}
+	} else {
+		LuaState::pushVariant(L, function);
+		if (lua_gettop(L) != top + 1 || lua_type(L, -1) != LUA_TFUNCTION) {
+			lua_settop(L, top);
+			return LuaError::newError("Function is not a Lua function.", LuaError::ERR_TYPE);
+		}
+	}
+
+	LuaState::pushVariant(L, self);
+	return addEntry();
+}
+
+// Adds the method of a global table as an entry with the table as self, so Lua objects keep their state between ticks.
+// The method is looked up once, replacing it in the table later does not change the entry.
+Variant LuaProcessGroup::addMethod(String tableName, String methodName) {
+	if (L == nullptr) {
+		return LuaError::newError("LuaProcessGroup is not bound to a LuaAPI.", LuaError::ERR_RUNTIME);
+	}
+
+	if (!parent->pushGlobalValue(tableName, LUA_TTABLE)) {
+		return LuaError::newError(vformat("Table \"%s\" does not exist.", tableName), LuaError::ERR_RUNTIME);
+	}
+
+	lua_getfield(L, -1, methodName.utf8().get_data());
+	if (lua_type(L, -1) != LUA_TFUNCTION) {
+		lua_pop(L, 2);
+		return LuaError::newError(vformat("Method \"%s\" does not exist in \"%s\".", methodName, tableName), LuaError::ERR_RUNTIME);
+	}
+
+	lua_insert(L, -2);
+	return addEntry();
+}
+
+// Removing an entry while ticking takes effect right away, it is not called again.
+bool LuaProcessGroup::remove(int64_t id) {
+	if (!has(id)) {
+		return false;
+	}
+
+	freeEntry((uint32_t)(id & 0xFFFFFFFF));
+	return true;
+}
+
+bool LuaProcessGroup::has(int64_t id) const {
+	return getEntry(id) != nullptr;
+}
+
+void LuaProcessGroup::clear() {
+	for (uint32_t slot : order) {
+		if (entries[slot].alive) {
+			freeEntry(slot);
+		}
+	}
+}
+
+// Calls every entry once in the order they were added. Entries added during the tick first run on the next one.
+// An error only stops its own entry, it is reported with entry_failed. Returns the number of entries called.
+int LuaProcessGroup::tick(double delta) {
+	ERR_FAIL_COND_V_MSG(L == nullptr, 0, "LuaProcessGroup is not bound to a LuaAPI.");
+	ERR_FAIL_COND_V_MSG(ticking, 0, "LuaProcessGroup.tick cannot be called from an entry.");
+
+	// An entry_failed handler may drop the last reference to the group
+	Ref<LuaProcessGroup> keepAlive(this);
+
+	if (removedPending) {
+		compact();
+	}
+
+	ticking = true;
+	uint64_t tickStart = profiling ? get_ticks_usec() : 0;
+
+	int top = lua_gettop(L);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, parent->getErrorHandlerRef());
+	int handlerIndex = top + 1;
+
+	// Callbacks may add entries, so entries is indexed again after each call instead of holding a reference
+	uint32_t size = order.size();
+	int called = 0;
+	for (uint32_t i = 0; i < size; i++) {
+		uint32_t slot = order[i];
+		if (!entries[slot].alive) {
+			continue;
+		}
+
+		int64_t id = makeId(slot, entries[slot].generation);
+		lua_rawgeti(L, LUA_REGISTRYINDEX, entries[slot].funcRef);
+		int argc = 1;
+		if (entries[slot].selfRef != LUA_NOREF) {
+			lua_rawgeti(L, LUA_REGISTRYINDEX, entries[slot].selfRef);
+			argc = 2;
+		}
+		lua_pushnumber(L, delta);
+
+		uint64_t start = profiling ? get_ticks_usec() : 0;
+		Ref<LuaError> err;
+		{
+			LuaAPI::ExecutionScope scope(parent.ptr(), L);
+			int ret = lua_pcall(L, argc, 0, handlerIndex);
+			if (ret != LUA_OK) {
+				// Typed while the scope still knows whether the execution limit raised it
+				err = LuaState::handleError(L, ret);
+			}
+		}
+		if (profiling) {
+			entries[slot].timeUsec = get_ticks_usec() - start;
+		}
+		lua_settop(L, handlerIndex);
+		called++;
+
+		if (err.is_valid()) {
+			emit_signal("entry_failed", id, err);
+		}
+	}
+
+	lua_settop(L, top);
+	ticking = false;
+
+	if (profiling) {
+		tickTimeUsec = get_ticks_usec() - tickStart;
+	}
+
+	if (removedPending) {
+		compact();
+	}
+	return called;
+}
+
+void LuaProcessGroup::setProfiling(bool value) {
+	profiling = value;
+}
+
+bool LuaProcessGroup::getProfiling() const {
+	return profiling;
+}
+
+int LuaProcessGroup::getCount() const {
+	return count;
+}
+
+// The ids of every entry in call order
+PackedInt64Array LuaProcessGroup::getIds() const {
+	PackedInt64Array ids;
+	ids.resize(count);
+	int i = 0;
+	for (uint32_t slot : order) {
+		if (entries[slot].alive) {
+			ids.set(i++, makeId(slot, entries[slot].generation));
+		}
+	}
+	return ids;
+}
+
+// Time the entry took in the last tick with profiling on, or -1 if there is no such entry
+int64_t LuaProcessGroup::getEntryTimeUsec(int64_t id) const {
+	const Entry *entry = getEntry(id);
+	if (entry == nullptr) {
+		return -1;
+	}
+	return entry->timeUsec;
+}
+
+int64_t LuaProcessGroup::getTickTimeUsec() const {
+	return tickTimeUsec;
+}
+
+int64_t LuaProcessGroup::makeId(uint32_t slot, uint32_t generation) {
+	return ((int64_t)generation << 32) | slot;
+}
+
+const LuaProcessGroup::Entry *LuaProcessGroup::getEntry(int64_t id) const {
+	uint32_t slot = (uint32_t)(id & 0xFFFFFFFF);
+	uint32_t generation = (uint32_t)(id >> 32);
+	if (id < 0 || slot >= entries.size()) {
+		return nullptr;
+	}
+
+	const Entry &entry = entries[slot];
+	if (!entry.alive || entry.generation != generation) {
+		return nullptr;
+	}
+	return &entry;
+}
+
+// Takes the function and self from the top of the main stack, a nil self means the function gets no self argument
+Variant LuaProcessGroup::addEntry() {
+	int selfRef = LUA_NOREF;
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+	} else {
+		selfRef = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+	int funcRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	uint32_t slot;
+	if (!freeSlots.is_empty()) {
+		slot = freeSlots[freeSlots.size() - 1];
+		freeSlots.resize(freeSlots.size() - 1);
+	} else {
+		slot = entries.size();
+		entries.push_back(Entry());
+		entries[slot].generation = 1;
+	}
+
+	Entry &entry = entries[slot];
+	entry.funcRef = funcRef;
+	entry.selfRef = selfRef;
+	entry.alive = true;
+	entry.timeUsec = 0;
+	order.push_back(slot);
+	count++;
+	return makeId(slot, entry.generation);
+}
+
+// The slot stays in order until compact, so it can not be reused while a tick may still reach it
+void LuaProcessGroup::freeEntry(uint32_t slot) {
+	Entry &entry = entries[slot];
+	luaL_unref(L, LUA_REGISTRYINDEX, entry.funcRef);
+	luaL_unref(L, LUA_REGISTRYINDEX, entry.selfRef);
+	entry.funcRef = LUA_NOREF;
+	entry.selfRef = LUA_NOREF;
+	entry.alive = false;
+	entry.generation++;
+	count--;
+	removedPending = true;
+}
+
+// Drops removed entries from order, keeping the rest in order, and makes their slots reusable
+void LuaProcessGroup::compact() {
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < order.size(); i++) {
+		uint32_t slot = order[i];
+		if (entries[slot].alive) {
+			order[kept++] = slot;
+		} else {
+			freeSlots.push_back(slot);
+		}
+	}
+	order.resize(kept);
+	removedPending = false;
+}
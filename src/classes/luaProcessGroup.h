@@ -0,0 +1,81 @@
+#ifndef LUAPROCESSGROUP_H
+#define LUAPROCESSGROUP_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/object/ref_counted.h"
+#include "core/templates/local_vector.h"
+#else
+#include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
+#endif
+
+#include "luaError.h"
+
+#include <lua/lua.hpp>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+class LuaAPI;
+
+// Calls many Lua update functions from a single tick call. Each entry keeps its function and self value in the registry,
+// so a tick only pushes the error handler once and then the function, self and delta of every entry.
+class LuaProcessGroup : public RefCounted {
+	GDCLASS(LuaProcessGroup, RefCounted);
+
+protected:
+	static void _bind_methods();
+
+public:
+	~LuaProcessGroup();
+
+	void bind(Ref<LuaAPI> lua);
+
+	Variant add(Variant function, Variant self);
+	Variant addMethod(String tableName, String methodName);
+	bool remove(int64_t id);
+	bool has(int64_t id) const;
+	void clear();
+
+	int tick(double delta);
+
+	void setProfiling(bool value);
+	bool getProfiling() const;
+
+	int getCount() const;
+	PackedInt64Array getIds() const;
+	int64_t getEntryTimeUsec(int64_t id) const;
+	int64_t getTickTimeUsec() const;
+
+private:
+	struct Entry {
+		int funcRef = LUA_NOREF;
+		int selfRef = LUA_NOREF; // No self argument when LUA_NOREF
+		uint32_t generation = 0;
+		bool alive = false;
+		int64_t timeUsec = 0; // Time spent in the last tick, only measured with profiling
+	};
+
+	Ref<LuaAPI> parent;
+	lua_State *L = nullptr;
+
+	LocalVector<Entry> entries;
+	LocalVector<uint32_t> order; // Slots in call order, removed entries stay until compact
+	LocalVector<uint32_t> freeSlots;
+	int count = 0;
+	bool removedPending = false;
+
+	bool ticking = false;
+	bool profiling = false;
+	int64_t tickTimeUsec = 0;
+
+	static int64_t makeId(uint32_t slot, uint32_t generation);
+	const Entry *getEntry(int64_t id) const;
+
+	Variant addEntry();
+	void freeEntry(uint32_t slot);
+	void compact();
+};
+
+#endif
@@ -0,0 +1,542 @@
+#include "luaScheduler.h"
+
+#include <classes/luaAPI.h>
+#include <luaState.h>
+#include <util.h>
+
+// Address used to tell scheduler yields apart from plain coroutine.yield calls
+static char schedulerYieldKey;
+
+void LuaScheduler::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("bind", "lua"), &LuaScheduler::bind);
+	ClassDB::bind_method(D_METHOD("spawn", "LuaFunctionName", "Args", "Priority"), &LuaScheduler::spawn, DEFVAL(Array()), DEFVAL(PRIORITY_NORMAL));
+	ClassDB::bind_method(D_METHOD("cancel", "id"), &LuaScheduler::cancel);
+	ClassDB::bind_method(D_METHOD("is_alive", "id"), &LuaScheduler::isAlive);
+
+	ClassDB::bind_method(D_METHOD("tick", "delta"), &LuaScheduler::tick);
+	ClassDB::bind_method(D_METHOD("notify", "event", "Args"), &LuaScheduler::notify, DEFVAL(Array()));
+
+	ClassDB::bind_method(D_METHOD("set_budget_usec", "value"), &LuaScheduler::setBudgetUsec);
+	ClassDB::bind_method(D_METHOD("get_budget_usec"), &LuaScheduler::getBudgetUsec);
+
+	ClassDB::bind_method(D_METHOD("get_task_count"), &LuaScheduler::getTaskCount);
+	ClassDB::bind_method(D_METHOD("get_runnable_count"), &LuaScheduler::getRunnableCount);
+	ClassDB::bind_method(D_METHOD("get_time"), &LuaScheduler::getTime);
+	ClassDB::bind_method(D_METHOD("get_frame"), &LuaScheduler::getFrame);
+
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "budget_usec"), "set_budget_usec", "get_budget_usec");
+
+	ADD_SIGNAL(MethodInfo("task_finished", PropertyInfo(Variant::INT, "id"), PropertyInfo(Variant::ARRAY, "results")));
+	ADD_SIGNAL(MethodInfo("task_failed", PropertyInfo(Variant::INT, "id"), PropertyInfo(Variant::OBJECT, "error", PROPERTY_HINT_RESOURCE_TYPE, "LuaError")));
+
+	BIND_ENUM_CONSTANT(PRIORITY_HIGH);
+	BIND_ENUM_CONSTANT(PRIORITY_NORMAL);
+	BIND_ENUM_CONSTANT(PRIORITY_LOW);
+}
+
+LuaScheduler::~LuaScheduler() {
+	if (L == nullptr) {
+		return;
+	}
+
+	for (const Task &task : tasks) {
+		if (task.state != TASK_FREE) {
+			luaL_unref(L, LUA_REGISTRYINDEX, task.threadRef);
+		}
+	}
+}
+
+// Binds the scheduler to a LuaAPI and registers wait, wait_frames and wait_event as globals
+void LuaScheduler::bind(Ref<LuaAPI> lua) {
+	ERR_FAIL_COND_MSG(taskCount > 0, "Cannot rebind a LuaScheduler with running tasks.");
+	parent = lua;
+	L = lua->getState();
+
+	lua_register(L, "wait", luaWait);
+	lua_register(L, "wait_frames", luaWaitFrames);
+	lua_register(L, "wait_event", luaWaitEvent);
+}
+
+// Starts the function as a new task. It first runs on the next tick. Returns the task id or a LuaError.
+Variant LuaScheduler::spawn(String functionName, Array args, Priority priority) {
+	if (L == nullptr) {
+		return LuaError::newError("LuaScheduler is not bound to a LuaAPI.", LuaError::ERR_RUNTIME);
+	}
+
+	if (priority < 0 || priority >= PRIORITY_MAX) {
+		return LuaError::newError(vformat("Invalid priority %d.", priority), LuaError::ERR_RUNTIME);
+	}
+
+	if (!parent->pushGlobalFunction(functionName)) {
+		return LuaError::newError(vformat("Function \"%s\" does not exist.", functionName), LuaError::ERR_RUNTIME);
+	}
+
+	// The registry ref keeps the thread alive, nothing is left on the main stack
+	lua_State *thread = lua_newthread(L);
+	int threadRef = luaL_ref(L, LUA_REGISTRYINDEX);
+	lua_xmove(L, thread, 1);
+
+	uint32_t slot;
+	if (!freeSlots.is_empty()) {
+		slot = freeSlots[freeSlots.size() - 1];
+		freeSlots.resize(freeSlots.size() - 1);
+	} else {
+		slot = tasks.size();
+		tasks.push_back(Task());
+		tasks[slot].generation = 1;
+	}
+
+	Task &task = tasks[slot];
+	task.thread = thread;
+	task.threadRef = threadRef;
+	task.priority = priority;
+	task.started = false;
+	task.resumeArgs = args;
+	taskCount++;
+
+	makeRunnable(slot);
+	return makeId(slot, task.generation);
+}
+
+// Stops the task without resuming it again. Returns false if there is no such task.
+bool LuaScheduler::cancel(int64_t id) {
+	Task *task = getTask(id);
+	if (task == nullptr) {
+		return false;
+	}
+
+	uint32_t slot = (uint32_t)(id & 0xFFFFFFFF);
+	if (slot == running) {
+		runningCancelled = true;
+		return true;
+	}
+
+	freeTask(slot);
+	return true;
+}
+
+bool LuaScheduler::isAlive(int64_t id) const {
+	return getTask(id) != nullptr;
+}
+
+// Advances time by delta and the frame count by one, then resumes every task that is due, high priority first.
+// With a budget, tasks left over once it is spent run first on the next tick. Returns the number of tasks resumed.
+int LuaScheduler::tick(double delta) {
+	ERR_FAIL_COND_V_MSG(ticking, 0, "LuaScheduler.tick cannot be called from a task.");
+	ticking = true;
+
+	time += delta;
+	frame++;
+
+	while (!timeHeap.is_empty() && timeHeap[0].wake <= time) {
+		Sleeper sleeper = heapPop(timeHeap);
+		if (tasks[sleeper.slot].generation == sleeper.generation && tasks[sleeper.slot].state == TASK_WAIT_TIME) {
+			makeRunnable(sleeper.slot);
+		} else if (staleTime > 0) {
+			staleTime--;
+		}
+	}
+
+	while (!frameHeap.is_empty() && frameHeap[0].wake <= frame) {
+		Sleeper sleeper = heapPop(frameHeap);
+		if (tasks[sleeper.slot].generation == sleeper.generation && tasks[sleeper.slot].state == TASK_WAIT_FRAMES) {
+			makeRunnable(sleeper.slot);
+		} else if (staleFrames > 0) {
+			staleFrames--;
+		}
+	}
+
+	uint64_t start = budgetUsec > 0 ? get_ticks_usec() : 0;
+	int resumed = 0;
+	bool outOfBudget = false;
+	for (int p = 0; p < PRIORITY_MAX && !outOfBudget; p++) {
+		while (readyHead[p] < ready[p].size()) {
+			if (budgetUsec > 0 && resumed > 0 && get_ticks_usec() - start >= (uint64_t)budgetUsec) {
+				outOfBudget = true;
+				break;
+			}
+
+			Sleeper entry = ready[p][readyHead[p]++];
+			if (tasks[entry.slot].generation != entry.generation || tasks[entry.slot].state != TASK_RUNNABLE) {
+				continue;
+			}
+
+			resumeTask(entry.slot);
+			resumed++;
+		}
+	}
+
+	// Drop the entries that were consumed, keeping the rest in order
+	for (int p = 0; p < PRIORITY_MAX; p++) {
+		uint32_t head = readyHead[p];
+		if (head == 0) {
+			continue;
+		}
+
+		uint32_t remaining = ready[p].size() - head;
+		for (uint32_t i = 0; i < remaining; i++) {
+			ready[p][i] = ready[p][head + i];
+		}
+		ready[p].resize(remaining);
+		readyHead[p] = 0;
+	}
+
+	ticking = false;
+	return resumed;
+}
+
+// Wakes every task waiting on event, wait_event returns args to them. They run on the next tick.
+// Returns the number of tasks woken.
+int LuaScheduler::notify(StringName event, Array args) {
+	LocalVector<Sleeper> *waiters = eventWaiters.getptr(event);
+	if (waiters == nullptr) {
+		return 0;
+	}
+
+	LocalVector<Sleeper> woken = *waiters;
+	eventWaiters.erase(event);
+
+	int count = 0;
+	for (const Sleeper &sleeper : woken) {
+		Task &task = tasks[sleeper.slot];
+		if (task.generation != sleeper.generation || task.state != TASK_WAIT_EVENT) {
+			continue;
+		}
+
+		task.resumeArgs = args;
+		task.event = StringName();
+		makeRunnable(sleeper.slot);
+		count++;
+	}
+	return count;
+}
+
+void LuaScheduler::setBudgetUsec(int value) {
+	budgetUsec = value;
+}
+
+int LuaScheduler::getBudgetUsec() const {
+	return budgetUsec;
+}
+
+int LuaScheduler::getTaskCount() const {
+	return taskCount;
+}
+
+int LuaScheduler::getRunnableCount() const {
+	int count = 0;
+	for (int p = 0; p < PRIORITY_MAX; p++) {
+		for (uint32_t i = readyHead[p]; i < ready[p].size(); i++) {
+			const Sleeper &entry = ready[p][i];
+			if (tasks[entry.slot].generation == entry.generation && tasks[entry.slot].state == TASK_RUNNABLE) {
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+double LuaScheduler::getTime() const {
+	return time;
+}
+
+int64_t LuaScheduler::getFrame() const {
+	return frame;
+}
+
+int64_t LuaScheduler::makeId(uint32_t slot, uint32_t generation) {
+	return ((int64_t)generation << 32) | slot;
+}
+
+LuaScheduler::Task *LuaScheduler::getTask(int64_t id) {
+	return const_cast<Task *>(static_cast<const LuaScheduler *>(this)->getTask(id));
+}
+
+const LuaScheduler::Task *LuaScheduler::getTask(int64_t id) const {
+	uint32_t slot = (uint32_t)(id & 0xFFFFFFFF);
+	uint32_t generation = (uint32_t)(id >> 32);
+	if (id < 0 || slot >= tasks.size()) {
+		return nullptr;
+	}
+
+	const Task &task = tasks[slot];
+	if (task.state == TASK_FREE || task.generation != generation) {
+		return nullptr;
+	}
+	return &task;
+}
+
+void LuaScheduler::heapPush(LocalVector<Sleeper> &heap, const Sleeper &sleeper) {
+	uint32_t i = heap.size();
+	heap.push_back(sleeper);
+	while (i > 0) {
+		uint32_t parentIndex = (i - 1) / 2;
+		if (heap[parentIndex].wake <= heap[i].wake) {
+			break;
+		}
+		SWAP(heap[parentIndex], heap[i]);
+		i = parentIndex;
+	}
+}
+
+LuaScheduler::Sleeper LuaScheduler::heapPop(LocalVector<Sleeper> &heap) {
+	Sleeper top = heap[0];
+	heap[0] = heap[heap.size() - 1];
+	heap.resize(heap.size() - 1);
+
+	uint32_t i = 0;
+	uint32_t size = heap.size();
+	while (true) {
+		uint32_t smallest = i;
+		uint32_t left = i * 2 + 1;
+		uint32_t right = left + 1;
+		if (left < size && heap[left].wake < heap[smallest].wake) {
+			smallest = left;
+		}
+		if (right < size && heap[right].wake < heap[smallest].wake) {
+			smallest = right;
+		}
+		if (smallest == i) {
+			break;
+		}
+		SWAP(heap[smallest], heap[i]);
+		i = smallest;
+	}
+	return top;
+}
+
+void LuaScheduler::makeRunnable(uint32_t slot) {
+	Task &task = tasks[slot];
+	task.state = TASK_RUNNABLE;
+
+	Sleeper entry;
+	entry.slot = slot;
+	entry.generation = task.generation;
+	ready[task.priority].push_back(entry);
+}
+
+void LuaScheduler::resumeTask(uint32_t slot) {
+	lua_State *thread = tasks[slot].thread;
+	uint32_t generation = tasks[slot].generation;
+	Array args = tasks[slot].resumeArgs;
+	tasks[slot].resumeArgs = Array();
+	tasks[slot].started = true;
+
+	// The thread is not running, so values pushVariant would fail on or raise are passed as nil instead
+	int top = lua_gettop(thread);
+	for (int i = 0; i < args.size(); i++) {
+		if (LuaState::checkPushable(args[i]).is_valid()) {
+			lua_pushnil(thread);
+		} else {
+			LuaState::pushVariant(thread, args[i]);
+		}
+	}
+	int nargs = lua_gettop(thread) - top;
+
+	// Callbacks from the task may spawn or cancel tasks, so tasks is indexed again afterwards instead of holding a reference
+	running = slot;
+	runningCancelled = false;
+	LuaAPI::ExecutionScope scope(parent.ptr(), thread);
+#ifndef LAPI_LUAJIT
+	int nresults = 0;
+	int ret = lua_resume(thread, nullptr, nargs, &nresults);
+#else
+	int ret = lua_resume(thread, nargs);
+	int nresults = lua_gettop(thread);
+#endif
+	running = UINT32_MAX;
+
+	int64_t id = makeId(slot, generation);
+	if (ret == LUA_YIELD) {
+		if (runningCancelled) {
+			freeTask(slot);
+		} else {
+			park(slot, nresults);
+		}
+		return;
+	}
+
+	if (ret != LUA_OK) {
+		Ref<LuaError> err = LuaState::handleError(thread, ret);
+		freeTask(slot);
+		emit_signal("task_failed", id, err);
+		return;
+	}
+
+	Array results;
+	results.resize(nresults);
+	for (int i = 0; i < nresults; i++) {
+		results[i] = LuaState::getVariant(thread, i + 1);
+	}
+	freeTask(slot);
+	emit_signal("task_finished", id, results);
+}
+
+// Files the task under whatever it yielded for. Plain yields wait for the next tick.
+void LuaScheduler::park(uint32_t slot, int nresults) {
+	Task &task = tasks[slot];
+	lua_State *thread = task.thread;
+
+	Sleeper sleeper;
+	sleeper.slot = slot;
+	sleeper.generation = task.generation;
+
+	int base = lua_gettop(thread) - nresults + 1;
+	if (nresults == 3 && lua_touserdata(thread, base) == &schedulerYieldKey) {
+		TaskState kind = (TaskState)lua_tointeger(thread, base + 1);
+		switch (kind) {
+			case TASK_WAIT_TIME:
+				task.state = TASK_WAIT_TIME;
+				sleeper.wake = time + MAX(lua_tonumber(thread, base + 2), 0.0);
+				heapPush(timeHeap, sleeper);
+				break;
+			case TASK_WAIT_EVENT:
+				task.state = TASK_WAIT_EVENT;
+				task.event = StringName(String::utf8(lua_tostring(thread, base + 2)));
+				if (LocalVector<Sleeper> *waiters = eventWaiters.getptr(task.event); waiters != nullptr) {
+					waiters->push_back(sleeper);
+				} else {
+					LocalVector<Sleeper> newWaiters;
+					newWaiters.push_back(sleeper);
+					eventWaiters.insert(task.event, newWaiters);
+				}
+				break;
+			default:
+				task.state = TASK_WAIT_FRAMES;
+				sleeper.wake = (double)(frame + MAX(lua_tointeger(thread, base + 2), (lua_Integer)1));
+				heapPush(frameHeap, sleeper);
+				break;
+		}
+	} else if (LuaState::isAwaitYield(thread, nresults)) {
+		// The signal wakes it, it still runs from tick like every other task
+		task.state = TASK_WAIT_SIGNAL;
+		parent->setAwaitOwner(thread, this, &LuaScheduler::resumeAwaitedTask, makeId(slot, task.generation));
+	} else {
+		task.state = TASK_WAIT_FRAMES;
+		sleeper.wake = (double)(frame + 1);
+		heapPush(frameHeap, sleeper);
+	}
+
+	lua_settop(thread, base - 1);
+}
+
+// Stale heap and queue entries are skipped by their generation. Event waiters are removed right away, since the event may never come.
+void LuaScheduler::freeTask(uint32_t slot) {
+	Task &task = tasks[slot];
+	TaskState previousState = task.state;
+	if (previousState == TASK_WAIT_EVENT) {
+		removeEventWaiter(slot);
+	}
+
+	luaL_unref(L, LUA_REGISTRYINDEX, task.threadRef);
+	task.thread = nullptr;
+	task.threadRef = LUA_NOREF;
+	task.state = TASK_FREE;
+	task.event = StringName();
+	task.resumeArgs = Array();
+	task.generation++;
+	freeSlots.push_back(slot);
+	taskCount--;
+
+	if (previousState == TASK_WAIT_TIME) {
+		staleTime++;
+		pruneHeap(timeHeap, staleTime, TASK_WAIT_TIME);
+	} else if (previousState == TASK_WAIT_FRAMES) {
+		staleFrames++;
+		pruneHeap(frameHeap, staleFrames, TASK_WAIT_FRAMES);
+	}
+}
+
+// Drops the entries of freed tasks once they make up half the heap, so cancelling long sleeps does not grow it without bound
+void LuaScheduler::pruneHeap(LocalVector<Sleeper> &heap, uint32_t &stale, TaskState state) {
+	if (heap.size() < MIN_PRUNE_SIZE || stale * 2 < heap.size()) {
+		return;
+	}
+
+	LocalVector<Sleeper> live;
+	live.reserve(heap.size() - stale);
+	for (const Sleeper &sleeper : heap) {
+		if (tasks[sleeper.slot].generation == sleeper.generation && tasks[sleeper.slot].state == state) {
+			heapPush(live, sleeper);
+		}
+	}
+	heap = live;
+	stale = 0;
+}
+
+// Takes the task out of the waiters of its event, keeping the others in order
+void LuaScheduler::removeEventWaiter(uint32_t slot) {
+	const Task &task = tasks[slot];
+	LocalVector<Sleeper> *waiters = eventWaiters.getptr(task.event);
+	if (waiters == nullptr) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < waiters->size(); i++) {
+		if ((*waiters)[i].slot == slot && (*waiters)[i].generation == task.generation) {
+			waiters->remove_at(i);
+			break;
+		}
+	}
+
+	if (waiters->is_empty()) {
+		eventWaiters.erase(task.event);
+	}
+}
+
+// The signal a task awaited fired, await returns its arguments on the next tick
+void LuaScheduler::resumeAwaitedTask(Object *owner, lua_State *thread, int64_t id, const Variant **args, int argc) {
+#ifndef LAPI_GDEXTENSION
+	LuaScheduler *scheduler = Object::cast_to<LuaScheduler>(owner);
+#else
+	// blame this on https://github.com/godotengine/godot-cpp/issues/995
+	LuaScheduler *scheduler = dynamic_cast<LuaScheduler *>(owner);
+#endif
+	if (scheduler == nullptr) {
+		return;
+	}
+
+	Task *task = scheduler->getTask(id);
+	if (task == nullptr || task->state != TASK_WAIT_SIGNAL) {
+		return;
+	}
+
+	Array resumeArgs;
+	resumeArgs.resize(argc);
+	for (int i = 0; i < argc; i++) {
+		resumeArgs[i] = *args[i];
+	}
+	task->resumeArgs = resumeArgs;
+	scheduler->makeRunnable((uint32_t)(id & 0xFFFFFFFF));
+}
+
+// wait(seconds)
+int LuaScheduler::luaWait(lua_State *state) {
+	lua_Number seconds = luaL_checknumber(state, 1);
+	lua_settop(state, 0);
+	lua_pushlightuserdata(state, &schedulerYieldKey);
+	lua_pushinteger(state, TASK_WAIT_TIME);
+	lua_pushnumber(state, seconds);
+	return lua_yield(state, 3);
+}
+
+// wait_frames(frames)
+int LuaScheduler::luaWaitFrames(lua_State *state) {
+	lua_Integer frames = luaL_optinteger(state, 1, 1);
+	lua_settop(state, 0);
+	lua_pushlightuserdata(state, &schedulerYieldKey);
+	lua_pushinteger(state, TASK_WAIT_FRAMES);
+	lua_pushinteger(state, frames);
+	return lua_yield(state, 3);
+}
+
+// wait_event(name), returns the arguments given to LuaScheduler.notify
+int LuaScheduler::luaWaitEvent(lua_State *state) {
+	luaL_checkstring(state, 1);
+	lua_settop(state, 1);
+	lua_pushlightuserdata(state, &schedulerYieldKey);
+	lua_insert(state, 1);
+	lua_pushinteger(state, TASK_WAIT_EVENT);
+	lua_insert(state, 2);
+	return lua_yield(state, 3);
+}
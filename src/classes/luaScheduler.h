@@ -0,0 +1,138 @@
+#ifndef LUASCHEDULER_H
+#define LUASCHEDULER_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/object/ref_counted.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/local_vector.h"
+#else
+#include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
+#endif
+
+#include "luaError.h"
+
+#include <lua/lua.hpp>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+class LuaAPI;
+
+// Runs many Lua coroutines from a single tick call. Coroutines park themselves with wait, wait_frames and wait_event,
+// sleepers are kept in heaps so each tick only touches the ones that are due.
+class LuaScheduler : public RefCounted {
+	GDCLASS(LuaScheduler, RefCounted);
+
+protected:
+	static void _bind_methods();
+
+public:
+	enum Priority {
+		PRIORITY_HIGH,
+		PRIORITY_NORMAL,
+		PRIORITY_LOW,
+		PRIORITY_MAX,
+	};
+
+	~LuaScheduler();
+
+	void bind(Ref<LuaAPI> lua);
+
+	Variant spawn(String functionName, Array args, Priority priority);
+	bool cancel(int64_t id);
+	bool isAlive(int64_t id) const;
+
+	int tick(double delta);
+	int notify(StringName event, Array args);
+
+	void setBudgetUsec(int value);
+	int getBudgetUsec() const;
+
+	int getTaskCount() const;
+	int getRunnableCount() const;
+	double getTime() const;
+	int64_t getFrame() const;
+
+private:
+	enum TaskState {
+		TASK_FREE,
+		TASK_RUNNABLE,
+		TASK_WAIT_TIME,
+		TASK_WAIT_FRAMES,
+		TASK_WAIT_EVENT,
+		TASK_WAIT_SIGNAL, // await(signal), resumed through LuaAPI::setAwaitOwner
+	};
+
+	struct Task {
+		lua_State *thread = nullptr;
+		int threadRef = LUA_NOREF;
+		uint32_t generation = 0;
+		TaskState state = TASK_FREE;
+		Priority priority = PRIORITY_NORMAL;
+		bool started = false;
+		StringName event;
+		Array resumeArgs; // Passed to the next resume, the spawn arguments or the event arguments
+	};
+
+	struct Sleeper {
+		double wake = 0; // Time for wait, frame for wait_frames
+		uint32_t slot = 0;
+		uint32_t generation = 0;
+	};
+
+	Ref<LuaAPI> parent;
+	lua_State *L = nullptr;
+
+	LocalVector<Task> tasks;
+	LocalVector<uint32_t> freeSlots;
+	int taskCount = 0;
+
+	LocalVector<Sleeper> timeHeap;
+	LocalVector<Sleeper> frameHeap;
+	HashMap<StringName, LocalVector<Sleeper>> eventWaiters;
+
+	// Heap entries of freed tasks, the heap is rebuilt once they make up half of it
+	static const uint32_t MIN_PRUNE_SIZE = 64;
+	uint32_t staleTime = 0;
+	uint32_t staleFrames = 0;
+
+	// Tasks that are due, one queue per priority. Entries before readyHead were already resumed.
+	LocalVector<Sleeper> ready[PRIORITY_MAX];
+	uint32_t readyHead[PRIORITY_MAX] = {};
+
+	double time = 0;
+	int64_t frame = 0;
+	int budgetUsec = 0;
+	bool ticking = false;
+
+	// The task being resumed, cancelling it is deferred until it yields
+	uint32_t running = UINT32_MAX;
+	bool runningCancelled = false;
+
+	static int64_t makeId(uint32_t slot, uint32_t generation);
+	Task *getTask(int64_t id);
+	const Task *getTask(int64_t id) const;
+
+	static void heapPush(LocalVector<Sleeper> &heap, const Sleeper &sleeper);
+	static Sleeper heapPop(LocalVector<Sleeper> &heap);
+	void pruneHeap(LocalVector<Sleeper> &heap, uint32_t &stale, TaskState state);
+	void removeEventWaiter(uint32_t slot);
+
+	void makeRunnable(uint32_t slot);
+	void resumeTask(uint32_t slot);
+	void park(uint32_t slot, int nresults);
+	void freeTask(uint32_t slot);
+
+	static void resumeAwaitedTask(Object *owner, lua_State *thread, int64_t id, const Variant **args, int argc);
+
+	static int luaWait(lua_State *state);
+	static int luaWaitFrames(lua_State *state);
+	static int luaWaitEvent(lua_State *state);
+};
+
+VARIANT_ENUM_CAST(LuaScheduler::Priority)
+
+#endif
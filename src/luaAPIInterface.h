@@ -0,0 +1,102 @@
+#ifndef LUAAPI_INTERFACE_H
+#define LUAAPI_INTERFACE_H
+
+/*
+ * C interface for other native extensions to work with a LuaAPI's lua_State directly.
+ *
+ * Get the table from the "LuaAPINative" engine singleton:
+ *     const LuaAPINativeInterface *lua = (const LuaAPINativeInterface *)(intptr_t)(int64_t)
+ *             Engine::get_singleton()->get_singleton("LuaAPINative")->call("get_interface", LUAAPI_INTERFACE_VERSION);
+ *
+ * Every Lua call must go through this table rather than a Lua library linked into the caller,
+ * since the caller's copy of Lua may not match the one the state was created with.
+ * Type ids returned by type() are the standard Lua ones, LUA_TNIL (0) to LUA_TTHREAD (8).
+ * Functions which raise Lua errors longjmp through the caller, do not hold C++ objects with destructors across them.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LUAAPI_INTERFACE_VERSION 1
+
+typedef struct lua_State lua_State;
+typedef int (*LuaAPINativeFunction)(lua_State *L);
+
+// Entry of a library for register_library, the array ends with an entry whose name is NULL.
+typedef struct {
+	const char *name;
+	LuaAPINativeFunction func;
+} LuaAPINativeReg;
+
+typedef struct {
+	uint32_t version;
+	int registry_index; // LUA_REGISTRYINDEX of the Lua build the state uses
+
+	// States
+	lua_State *(*get_state)(uint64_t lua_api_instance_id); // NULL if the id is not a LuaAPI
+	uint64_t (*get_api_instance_id)(lua_State *L);
+
+	// Registration
+	void (*register_function)(lua_State *L, const char *name, LuaAPINativeFunction func);
+	void (*register_library)(lua_State *L, const char *name, const LuaAPINativeReg *funcs);
+	int (*new_metatable)(lua_State *L, const char *name); // Leaves the metatable on the stack, returns 0 if it already existed
+	void (*set_metatable)(lua_State *L, const char *name); // Sets the named metatable on the value at the top of the stack
+	void *(*test_userdata)(lua_State *L, int index, const char *name); // NULL if the value is not userdata with the named metatable
+
+	// Variants, each pointer is a godot Variant
+	// Returns 0 on success and pushes one value, or one per element for a LuaTuple. Returns nonzero for a LuaError, a LuaCoroutine
+	// or a type Lua can not hold, also nested in an Array, Dictionary or LuaTuple, and leaves the stack untouched.
+	int (*push_variant)(lua_State *L, const void *variant);
+	void (*get_variant)(lua_State *L, int index, void *r_variant); // r_variant must point to a constructed Variant
+
+	// Stack
+	int (*get_top)(lua_State *L);
+	void (*set_top)(lua_State *L, int index);
+	void (*push_value)(lua_State *L, int index);
+	void (*remove)(lua_State *L, int index);
+	int (*type)(lua_State *L, int index);
+	int (*upvalue_index)(int n);
+
+	// Pushing values
+	void (*push_nil)(lua_State *L);
+	void (*push_boolean)(lua_State *L, int value);
+	void (*push_integer)(lua_State *L, int64_t value);
+	void (*push_number)(lua_State *L, double value);
+	void (*push_string)(lua_State *L, const char *value, size_t length);
+	void (*push_closure)(lua_State *L, LuaAPINativeFunction func, int upvalues);
+	void (*push_light_userdata)(lua_State *L, void *pointer);
+
+	// Reading values
+	int (*to_boolean)(lua_State *L, int index);
+	int64_t (*to_integer)(lua_State *L, int index);
+	double (*to_number)(lua_State *L, int index);
+	const char *(*to_string)(lua_State *L, int index, size_t *r_length);
+	void *(*to_userdata)(lua_State *L, int index);
+
+	// Tables and userdata
+	void *(*new_userdata)(lua_State *L, size_t size);
+	void (*create_table)(lua_State *L, int array_size, int hash_size);
+	void (*get_field)(lua_State *L, int index, const char *key);
+	void (*set_field)(lua_State *L, int index, const char *key);
+	void (*raw_get_index)(lua_State *L, int index, int64_t n);
+	void (*raw_set_index)(lua_State *L, int index, int64_t n);
+
+	// Registry references
+	int (*ref)(lua_State *L); // Pops the top value and returns a reference to it
+	void (*unref)(lua_State *L, int ref);
+	void (*push_ref)(lua_State *L, int ref);
+
+	// Calls and errors
+	int (*pcall)(lua_State *L, int nargs, int nresults); // Uses the LuaAPI error handler, on failure the message is left on the stack
+	int (*error)(lua_State *L, const char *message); // Raises a Lua error, does not return
+} LuaAPINativeInterface;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef LUACALLARGS_H
+#define LUACALLARGS_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/os/memory.h"
+#include "core/variant/variant.h"
+#else
+#include <godot_cpp/core/memory.hpp>
+#include <godot_cpp/variant/variant.hpp>
+#endif
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+// Argument buffer for calls from Lua into Godot. Calls with up to INLINE_ARGS arguments do not allocate.
+class LuaCallArgs {
+public:
+	static const int INLINE_ARGS = 8;
+
+	explicit LuaCallArgs(int argc) :
+			argc(argc) {
+		if (argc > INLINE_ARGS) {
+			args = memnew_arr(Variant, argc);
+			argPtrs = (const Variant **)memalloc(sizeof(const Variant *) * argc);
+		} else {
+			args = inlineArgs;
+			argPtrs = inlinePtrs;
+		}
+
+		for (int i = 0; i < argc; i++) {
+			argPtrs[i] = &args[i];
+		}
+	}
+
+	~LuaCallArgs() {
+		if (args != inlineArgs) {
+			memdelete_arr(args);
+			memfree(argPtrs);
+		}
+	}
+
+	LuaCallArgs(const LuaCallArgs &) = delete;
+	LuaCallArgs &operator=(const LuaCallArgs &) = delete;
+
+	inline Variant &operator[](int index) { return args[index]; }
+	inline const Variant **ptr() const { return argPtrs; }
+	inline int size() const { return argc; }
+
+private:
+	Variant inlineArgs[INLINE_ARGS];
+	const Variant *inlinePtrs[INLINE_ARGS];
+
+	Variant *args;
+	const Variant **argPtrs;
+	int argc;
+};
+
+#endif
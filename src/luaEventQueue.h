@@ -0,0 +1,80 @@
+#ifndef LUAEVENTQUEUE_H
+#define LUAEVENTQUEUE_H
+
+#ifndef LAPI_GDEXTENSION
+#include "core/os/memory.h"
+#include "core/variant/variant.h"
+#else
+#include <godot_cpp/core/memory.hpp>
+#include <godot_cpp/variant/variant.hpp>
+#endif
+
+#include <atomic>
+
+#ifdef LAPI_GDEXTENSION
+using namespace godot;
+#endif
+
+// Lock-free multi-producer single-consumer queue of Variants. Any thread may push, only the thread that owns the Lua state pops.
+// Producers link their node with one atomic exchange on head, the consumer walks from tail without ever touching head.
+class LuaEventQueue {
+public:
+	LuaEventQueue() {
+		Node *stub = memnew(Node);
+		head.store(stub, std::memory_order_relaxed);
+		tail = stub;
+	}
+
+	~LuaEventQueue() {
+		Variant value;
+		while (pop(value)) {
+		}
+		memdelete(tail);
+	}
+
+	LuaEventQueue(const LuaEventQueue &) = delete;
+	LuaEventQueue &operator=(const LuaEventQueue &) = delete;
+
+	// Safe to call from any thread
+	void push(const Variant &value) {
+		Node *node = memnew(Node);
+		node->value = value;
+		size.fetch_add(1, std::memory_order_relaxed);
+		Node *previous = head.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	// Owning thread only. Returns false once empty, an event whose producer is between its exchange and its link
+	// is not visible yet and comes with a later pop.
+	bool pop(Variant &value) {
+		Node *next = tail->next.load(std::memory_order_acquire);
+		if (next == nullptr) {
+			return false;
+		}
+
+		// next becomes the new stub, so its value is moved out now
+		value = next->value;
+		next->value = Variant();
+		memdelete(tail);
+		tail = next;
+		size.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Only a hint while producers are pushing
+	int64_t getSize() const {
+		return size.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Node {
+		std::atomic<Node *> next{ nullptr };
+		Variant value;
+	};
+
+	std::atomic<Node *> head;
+	Node *tail = nullptr;
+	std::atomic<int64_t> size{ 0 };
+};
+
+#endif
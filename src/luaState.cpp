@@ -6,14 +6,17 @@
 #include <classes/luaCallableExtra.h>
 #include <classes/luaCoroutine.h>
 #include <classes/luaFunctionRef.h>
+#include <classes/luaJob.h>
 #include <classes/luaTuple.h>
 
+#include <luaCallArgs.h>
 #include <lua_libraries.h>
 
 #include <util.h>
 
 void LuaState::setState(lua_State *state, LuaAPI *api, bool bindAPI) {
 	this->L = state;
+	this->api = api;
 	if (!bindAPI) {
 		return;
 	}
@@ -21,21 +24,35 @@ void LuaState::setState(lua_State *state, LuaAPI *api, bool bindAPI) {
 	// push our custom print function so by default it prints to the GDConsole.
 	lua_register(L, "print", luaPrint);
 
+	// await is a Lua function around the yielding C function, so returning from the yield can end the await
+	// however the thread was resumed. Otherwise coroutine.resume would leave the signal free to resume it again later.
+	luaL_loadstring(L, "local suspend, finish = ... return function(signal) return finish(suspend(signal)) end");
+	lua_pushcfunction(L, luaAwait);
+	lua_pushcfunction(L, luaAwaitFinish);
+	lua_call(L, 2, 1);
+	lua_setglobal(L, "await");
+
 	// saving the object into registry
 	lua_pushstring(L, "__LAPI__");
 	lua_pushlightuserdata(L, api);
 	lua_rawset(L, LUA_REGISTRYINDEX);
 
+	// Function handles reuse this instead of pushing a new handler every call
+	lua_pushcfunction(L, luaErrorHandler);
+	errorHandlerRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
 	// Creating basic types metatables and saving them in registry
 	createVector2Metatable(); // "mt_Vector2"
 	createVector3Metatable(); // "mt_Vector3"
 	createColorMetatable(); // "mt_Color"
 	createRect2Metatable(); // "mt_Rect2"
 	createPlaneMetatable(); // "mt_Plane"
-	createSignalMetatable(); // "mt_Signal"
+	createSignalMetatable(); // "mt_Signal" and "mt_SignalConnection"
 	createObjectMetatable(); // "mt_Object"
 	createCallableMetatable(); // "mt_Callable"
 	createCallableExtraMetatable(); // "mt_CallableExtra"
+	createPropertyAccessorMetatable(); // "mt_PropertyAccessor"
+	createNodeIteratorMetatable(); // "mt_NodeIterator"
 
 	// Exposing basic types constructors
 	exposeConstructors();
@@ -45,6 +62,10 @@ lua_State *LuaState::getState() const {
 	return L;
 }
 
+int LuaState::getErrorHandlerRef() const {
+	return errorHandlerRef;
+}
+
 // Binds lua libraries with the lua state
 Ref<LuaError> LuaState::bindLibraries(TypedArray<String> libs) {
 	for (int i = 0; i < libs.size(); i++) {
@@ -54,20 +75,28 @@ Ref<LuaError> LuaState::bindLibraries(TypedArray<String> libs) {
 		if (libs[i] == "base") {
 			lua_register(L, "print", luaPrint);
 		}
+		if (libs[i] == "coroutine") {
+			// Wrapped so threads Lua can keep a reference to are never pooled, see LuaAPI::exposeThread
+			lua_getglobal(L, "coroutine");
+			if (lua_istable(L, -1)) {
+				lua_getfield(L, -1, "running");
+				lua_pushcclosure(L, luaCoroutineRunning, 1);
+				lua_setfield(L, -2, "running");
+			}
+			lua_pop(L, 1);
+		}
 	}
 	return nullptr;
 }
 
+// Calls LuaAPI::setThreadHook()
 void LuaState::setHook(Callable hook, int mask, int count) {
-	if (hook.is_null()) {
-		lua_sethook(L, nullptr, 0, 0);
-		return;
-	}
+	api->setThreadHook(L, hook, mask, count);
+}
 
-	lua_pushstring(L, "__HOOK");
-	pushVariant(hook);
-	lua_settable(L, LUA_REGISTRYINDEX);
-	lua_sethook(L, luaHook, mask, count);
+// Calls LuaAPI::setThreadHookFilter()
+void LuaState::setHookFilter(Dictionary breakpoints, PackedStringArray functions) {
+	api->setThreadHookFilter(L, breakpoints, functions);
 }
 
 void LuaState::indexForReading(String name) {
@@ -165,6 +194,9 @@ Ref<LuaError> LuaState::setRegistryValue(String name, Variant var) {
 
 // call a Lua function from GDScript
 Variant LuaState::callFunction(String functionName, Array args) {
+	// Restored before returning, so a call from a function Lua is calling leaves that call's stack as it was
+	int top = lua_gettop(L);
+
 	// push the error handler on to the stack
 	lua_pushcfunction(L, luaErrorHandler);
 
@@ -180,15 +212,174 @@ Variant LuaState::callFunction(String functionName, Array args) {
 	}
 
 	// error handlers index is -2 - args.size()
+	LuaAPI::ExecutionScope scope(api, L);
 	int ret = lua_pcall(L, args.size(), 1, -2 - args.size());
 	if (ret != LUA_OK) {
-		return handleError(ret);
+		Ref<LuaError> err = handleError(ret);
+		lua_settop(L, top);
+		return err;
 	}
 	Variant toReturn = getVar(-1); // get return value
-	lua_pop(L, 1); // pop err handler
+	lua_settop(L, top); // pop the return value and the err handler
 	return toReturn;
 }
 
+// Resolves the function once and returns a LuaFunctionRef to it, so repeated calls skip the name lookup
+Variant LuaState::getFunctionHandle(String functionName) {
+#ifndef LAPI_LUAJIT
+	lua_pushglobaltable(L);
+#else
+	lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+	indexForReading(functionName);
+	if (lua_type(L, -1) != LUA_TFUNCTION) {
+		lua_pop(L, 1);
+		return LuaError::newError(vformat("Function \"%s\" does not exist.", functionName), LuaError::ERR_RUNTIME);
+	}
+
+	Ref<LuaFunctionRef> funcRef = getAPI(L)->getFunctionRef(L, -1);
+	lua_pop(L, 1);
+	return funcRef;
+}
+
+// Pushes the function onto the main stack. Returns false with nothing pushed if there is no function by that name.
+bool LuaState::pushGlobalFunction(const String &functionName) {
+	return pushGlobalValue(functionName, LUA_TFUNCTION);
+}
+
+// Pushes the global at the dotted path onto the main stack. Returns false with nothing pushed if it is missing or not of the given Lua type.
+bool LuaState::pushGlobalValue(const String &name, int type) {
+#ifndef LAPI_LUAJIT
+	lua_pushglobaltable(L);
+#else
+	lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+	const LocalVector<CharString> &path = getPath(name);
+	for (uint32_t i = 0; i < path.size(); i++) {
+		if (lua_type(L, -1) != LUA_TTABLE) {
+			lua_pop(L, 1);
+			return false;
+		}
+		lua_getfield(L, -1, path[i].get_data());
+		lua_remove(L, -2);
+	}
+
+	if (lua_type(L, -1) != type) {
+		lua_pop(L, 1);
+		return false;
+	}
+	return true;
+}
+
+// Calls the function once per argument set, resolving it and pushing the error handler only once.
+// args is either an Array of argument Arrays, or an Array of equally sized columns (usually packed arrays) where call i gets element i of every column.
+// Returns a Dictionary of call index to LuaError for the calls that failed, or a LuaError if the batch could not be started.
+Variant LuaState::callFunctionBatch(String functionName, Array args, Array results) {
+	bool columns = args.size() > 0 && args[0].get_type() != Variant::ARRAY;
+	int count = args.size();
+	Vector<Array> columnArrays;
+	if (columns) {
+		columnArrays.resize(args.size());
+		for (int i = 0; i < args.size(); i++) {
+			if (args[i].get_type() < Variant::ARRAY) {
+				return LuaError::newError(vformat("Argument column %d is not an array.", i), LuaError::ERR_TYPE);
+			}
+
+			columnArrays.write[i] = args[i];
+			if (columnArrays[i].size() != columnArrays[0].size()) {
+				return LuaError::newError(vformat("Argument column %d has %d elements, expected %d.", i, columnArrays[i].size(), columnArrays[0].size()), LuaError::ERR_RUNTIME);
+			}
+		}
+		count = columnArrays[0].size();
+	}
+
+	int top = lua_gettop(L);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, errorHandlerRef);
+#ifndef LAPI_LUAJIT
+	lua_pushglobaltable(L);
+#else
+	lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+	indexForReading(functionName);
+	if (lua_type(L, -1) != LUA_TFUNCTION) {
+		lua_settop(L, top);
+		return LuaError::newError(vformat("Function \"%s\" does not exist.", functionName), LuaError::ERR_RUNTIME);
+	}
+
+	int handlerIndex = top + 1;
+	int funcIndex = top + 2;
+	results.resize(count);
+	Dictionary errors;
+	for (int i = 0; i < count; i++) {
+		lua_pushvalue(L, funcIndex);
+
+		int argc = 0;
+		if (columns) {
+			argc = columnArrays.size();
+			for (int j = 0; j < argc; j++) {
+				pushVariant(columnArrays[j][i]);
+			}
+		} else {
+			Array row = args[i];
+			argc = row.size();
+			for (int j = 0; j < argc; j++) {
+				pushVariant(row[j]);
+			}
+		}
+
+		LuaAPI::ExecutionScope scope(api, L);
+		int ret = lua_pcall(L, argc, 1, handlerIndex);
+		if (ret != LUA_OK) {
+			// handleError pops the error message
+			errors[i] = handleError(ret);
+			results[i] = Variant();
+			continue;
+		}
+
+		results[i] = getVar(-1);
+		lua_pop(L, 1);
+	}
+
+	lua_settop(L, top);
+	return errors;
+}
+
+// Like callFunction but keeps every value the function returns. results is resized to the number of returns, so reusing the same Array avoids reallocating it each call.
+Ref<LuaError> LuaState::callFunctionInto(String functionName, Array args, Array results) {
+	int top = lua_gettop(L);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, errorHandlerRef);
+#ifndef LAPI_LUAJIT
+	lua_pushglobaltable(L);
+#else
+	lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+	indexForReading(functionName);
+	for (int i = 0; i < args.size(); ++i) {
+		pushVariant(args[i]);
+	}
+
+	LuaAPI::ExecutionScope scope(api, L);
+	int ret = lua_pcall(L, args.size(), LUA_MULTRET, top + 1);
+	if (ret != LUA_OK) {
+		Ref<LuaError> err = handleError(ret);
+		lua_settop(L, top);
+		return err;
+	}
+
+	readResults(L, top + 2, results);
+	lua_settop(L, top);
+	return nullptr;
+}
+
+// Copies everything from index to the top of the stack into results
+void LuaState::readResults(lua_State *state, int index, Array &results) {
+	int count = lua_gettop(state) - index + 1;
+	results.resize(count);
+	for (int i = 0; i < count; i++) {
+		results[i] = getVariant(state, index + i);
+	}
+}
+
 // Push a GD Variant to the lua stack and returns a error if the type is not supported
 Ref<LuaError> LuaState::pushVariant(Variant var) const {
 	return LuaState::pushVariant(L, var);
@@ -216,6 +407,111 @@ Ref<LuaError> LuaState::pushGlobalVariant(String name, Variant var) {
 	return err;
 }
 
+// Sets every name in vars with the global table pushed once.
+// Returns a Dictionary of name to LuaError for the names that could not be set, empty if all were.
+Dictionary LuaState::pushGlobalVariants(Dictionary vars) {
+	Dictionary errors;
+	int top = lua_gettop(L);
+#ifndef LAPI_LUAJIT
+	lua_pushglobaltable(L);
+#else
+	lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+	int globals = top + 1;
+
+	Array keys = vars.keys();
+	for (int i = 0; i < keys.size(); i++) {
+		// The original key indexes vars and errors, a StringName key would not find its value under the converted String
+		const Variant &key = keys[i];
+		const LocalVector<CharString> &path = getPath(key);
+
+		lua_pushvalue(L, globals);
+		bool indexed = true;
+		for (uint32_t j = 0; j + 1 < path.size(); j++) {
+			if (lua_type(L, -1) != LUA_TTABLE) {
+				indexed = false;
+				break;
+			}
+			lua_getfield(L, -1, path[j].get_data());
+			lua_remove(L, -2);
+		}
+
+		if (!indexed || lua_type(L, -1) != LUA_TTABLE) {
+			errors[key] = LuaError::newError("cannot index nil with string", LuaError::ERR_RUNTIME); // Same as push_variant
+			lua_settop(L, globals);
+			continue;
+		}
+
+		Ref<LuaError> err = pushVariant(vars[key]);
+		if (err.is_valid()) {
+			errors[key] = err;
+		} else {
+			lua_setfield(L, -2, path[path.size() - 1].get_data());
+		}
+		lua_settop(L, globals);
+	}
+
+	lua_settop(L, top);
+	return errors;
+}
+
+// Pulls every name with the global table pushed once. Element i of the result is the value of names[i], missing names are null like with pull_variant.
+Array LuaState::pullVariants(PackedStringArray names) {
+	Array values;
+	values.resize(names.size());
+
+	int top = lua_gettop(L);
+#ifndef LAPI_LUAJIT
+	lua_pushglobaltable(L);
+#else
+	lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+	int globals = top + 1;
+
+	for (int i = 0; i < names.size(); i++) {
+		const LocalVector<CharString> &path = getPath(names[i]);
+
+		lua_pushvalue(L, globals);
+		for (uint32_t j = 0; j < path.size(); j++) {
+			if (lua_type(L, -1) != LUA_TTABLE) {
+				lua_pop(L, 1);
+				lua_pushnil(L);
+				break;
+			}
+			lua_getfield(L, -1, path[j].get_data());
+			lua_remove(L, -2);
+		}
+
+		values[i] = getVar(-1);
+		lua_settop(L, globals);
+	}
+
+	lua_settop(L, top);
+	return values;
+}
+
+const LocalVector<CharString> &LuaState::getPath(const String &name) {
+	if (const LocalVector<CharString> *path = pathCache.getptr(name); path != nullptr) {
+		return *path;
+	}
+
+	// Names are usually a fixed set, if they are not just start over rather than growing forever
+	if (pathCache.size() >= MAX_CACHED_PATHS) {
+		pathCache.clear();
+	}
+
+	LocalVector<CharString> path;
+#ifndef LAPI_GDEXTENSION
+	Vector<String> strs = name.split(".");
+#else
+	PackedStringArray strs = name.split(".");
+#endif
+	for (const String &str : strs) {
+		path.push_back(str.utf8());
+	}
+	return pathCache.insert(name, path)->value;
+}
+
 Ref<LuaError> LuaState::handleError(int lua_error) const {
 	return LuaState::handleError(L, lua_error);
 }
@@ -391,10 +687,8 @@ Ref<LuaError> LuaState::pushVariant(lua_State *state, Variant var) {
 			// blame this on https://github.com/godotengine/godot-cpp/issues/995
 			if (Ref<LuaFunctionRef> funcRef = dynamic_cast<LuaFunctionRef *>(var.operator Object *()); funcRef.is_valid()) {
 #endif
+				// The registry is shared by every thread, moving from the handle's state would take an unrelated value off its stack
 				lua_rawgeti(state, LUA_REGISTRYINDEX, funcRef->getRef());
-				if (funcRef->getLuaState() != state) {
-					lua_xmove(funcRef->getLuaState(), state, 1);
-				}
 				break;
 			}
 
@@ -411,9 +705,24 @@ Ref<LuaError> LuaState::pushVariant(lua_State *state, Variant var) {
 				break;
 			}
 
-			Variant *userdata = (Variant *)lua_newuserdata(state, sizeof(Variant));
+			// Resources can keep far more memory alive than the userdata, let the collector know about it.
+			// The size is stored after the Variant so __gc can take it back off.
+			LuaAPI *api = nullptr;
+			uint64_t externalSize = 0;
+			if (Object::cast_to<RefCounted>(var.operator Object *()) != nullptr) {
+				api = getAPI(state);
+				if (api != nullptr && api->getReportExternalMemory()) {
+					externalSize = api->estimateExternalSize(var);
+				}
+			}
+
+			Variant *userdata = (Variant *)lua_newuserdata(state, externalSize > 0 ? sizeof(Variant) + sizeof(uint64_t) : sizeof(Variant));
 			memnew_placement(userdata, Variant(var));
 			luaL_setmetatable(state, "mt_Object");
+			if (externalSize > 0) {
+				*(uint64_t *)(userdata + 1) = externalSize;
+				api->addExternalMemory(state, externalSize);
+			}
 			break;
 		}
 		case Variant::Type::CALLABLE: {
@@ -430,9 +739,6 @@ Ref<LuaError> LuaState::pushVariant(lua_State *state, Variant var) {
 				LuaCallable *luaCallable = dynamic_cast<LuaCallable *>(custom);
 				if (luaCallable != nullptr) {
 					lua_rawgeti(state, LUA_REGISTRYINDEX, luaCallable->getFuncRef());
-					if (luaCallable->getLuaState() != state) {
-						lua_xmove(luaCallable->getLuaState(), state, 1);
-					}
 					break;
 				}
 
@@ -457,6 +763,101 @@ Ref<LuaError> LuaState::pushVariant(lua_State *state, Variant var) {
 	return nullptr;
 }
 
+// Returns the error pushVariant would report for var without touching any stack. A LuaError, also inside an Array, Dictionary or LuaTuple,
+// makes pushVariant raise it with lua_error, so it must be screened out wherever no Lua call is running to catch it.
+Ref<LuaError> LuaState::checkPushable(const Variant &var) {
+	switch (var.get_type()) {
+		case Variant::Type::NIL:
+		case Variant::Type::STRING:
+		case Variant::Type::INT:
+		case Variant::Type::FLOAT:
+		case Variant::Type::BOOL:
+		case Variant::Type::PACKED_BYTE_ARRAY:
+		case Variant::Type::PACKED_INT64_ARRAY:
+		case Variant::Type::PACKED_INT32_ARRAY:
+		case Variant::Type::PACKED_STRING_ARRAY:
+		case Variant::Type::PACKED_FLOAT64_ARRAY:
+		case Variant::Type::PACKED_FLOAT32_ARRAY:
+		case Variant::Type::PACKED_VECTOR2_ARRAY:
+		case Variant::Type::PACKED_VECTOR3_ARRAY:
+		case Variant::Type::PACKED_COLOR_ARRAY:
+		case Variant::Type::VECTOR2:
+		case Variant::Type::VECTOR3:
+		case Variant::Type::COLOR:
+		case Variant::Type::RECT2:
+		case Variant::Type::PLANE:
+		case Variant::Type::SIGNAL:
+		case Variant::Type::CALLABLE:
+			return nullptr;
+		case Variant::Type::ARRAY: {
+			Array array = var.operator Array();
+			for (int i = 0; i < array.size(); i++) {
+				Ref<LuaError> err = checkPushable(array[i]);
+				if (err.is_valid()) {
+					return err;
+				}
+			}
+			return nullptr;
+		}
+		case Variant::Type::DICTIONARY: {
+			Dictionary dict = var.operator Dictionary();
+			Array keys = dict.keys();
+			for (int i = 0; i < keys.size(); i++) {
+				Ref<LuaError> err = checkPushable(keys[i]);
+				if (err.is_null()) {
+					err = checkPushable(dict[keys[i]]);
+				}
+				if (err.is_valid()) {
+					return err;
+				}
+			}
+			return nullptr;
+		}
+		case Variant::Type::OBJECT: {
+			Object *obj = var.operator Object *();
+			if (obj == nullptr) {
+				return nullptr;
+			}
+
+#ifndef LAPI_GDEXTENSION
+			if (Ref<LuaError> err = Object::cast_to<LuaError>(obj); err.is_valid()) {
+#else
+			// blame this on https://github.com/godotengine/godot-cpp/issues/995
+			if (Ref<LuaError> err = dynamic_cast<LuaError *>(obj); err.is_valid()) {
+#endif
+				return err;
+			}
+
+#ifndef LAPI_GDEXTENSION
+			if (Ref<LuaTuple> tuple = Object::cast_to<LuaTuple>(obj); tuple.is_valid()) {
+#else
+			// blame this on https://github.com/godotengine/godot-cpp/issues/995
+			if (Ref<LuaTuple> tuple = dynamic_cast<LuaTuple *>(obj); tuple.is_valid()) {
+#endif
+				for (int i = 0; i < tuple->size(); i++) {
+					Ref<LuaError> err = checkPushable(tuple->get(i));
+					if (err.is_valid()) {
+						return err;
+					}
+				}
+				return nullptr;
+			}
+
+#ifndef LAPI_GDEXTENSION
+			if (Object::cast_to<LuaCoroutine>(obj) != nullptr) {
+#else
+			// blame this on https://github.com/godotengine/godot-cpp/issues/995
+			if (dynamic_cast<LuaCoroutine *>(obj) != nullptr) {
+#endif
+				return LuaError::newError("pushing threads is currently not supported.", LuaError::ERR_TYPE);
+			}
+			return nullptr;
+		}
+		default:
+			return LuaError::newError(vformat("can't pass Variants of type \"%s\" to Lua.", Variant::get_type_name(var.get_type())), LuaError::ERR_TYPE);
+	}
+}
+
 // gets a variant at a given index
 Variant LuaState::getVariant(lua_State *state, int index) {
 	Variant result;
@@ -516,26 +917,18 @@ Variant LuaState::getVariant(lua_State *state, int index) {
 		}
 		case LUA_TFUNCTION: {
 			Ref<LuaAPI> api = getAPI(state);
-			// Put function on the top of the stack and get a ref to it. This will create a copy of the function.
-			lua_pushvalue(state, index);
+			// Every handle to the same function shares one registry ref, see LuaAPI::acquireFunctionRef.
+			// Handles are bound to the main state, the running coroutine may be reset and pooled before they are called.
 			if (api->getUseCallables()) {
-				LuaCallable *callable = memnew(LuaCallable(api, luaL_ref(state, LUA_REGISTRYINDEX), state));
+				LuaCallable *callable = memnew(LuaCallable(api, api->acquireFunctionRef(state, index), lua_topointer(state, index), api->getState()));
 				result = Callable(callable);
 			} else {
-				Ref<LuaFunctionRef> funcRef;
-				funcRef.instantiate();
-				funcRef->setRef(luaL_ref(state, LUA_REGISTRYINDEX));
-				funcRef->setLuaState(state);
-				result = funcRef;
+				result = api->getFunctionRef(state, index);
 			}
 			break;
 		}
 		case LUA_TTHREAD: {
-			lua_State *tState = lua_tothread(state, index);
-			Ref<LuaCoroutine> thread;
-			thread.instantiate();
-			thread->bindExisting(getAPI(state), tState);
-			result = thread;
+			result = getAPI(state)->getCoroutine(state, index);
 			break;
 		}
 		case LUA_TNIL: {
@@ -556,8 +949,22 @@ Ref<LuaError> LuaState::handleError(lua_State *state, int lua_error) {
 			utf8_str.parse_utf8(lua_tostring(state, -1));
 			msg += "[LUA_ERRRUN - runtime error ]\n";
 			msg += utf8_str;
-			msg += "\n";
 			lua_pop(state, 1);
+
+			LuaAPI *api = getAPI(state);
+			LuaError::ErrorType type = api->executionLimitHit() ? LuaError::ERR_EXECUTION_LIMIT : LuaError::ERR_RUNTIME;
+
+			// In lazy mode the traceback is appended by LuaError::getMessage along with the trailing newline
+			Vector<LuaError::TraceFrame> &trace = api->getPendingTrace();
+			if (!trace.is_empty()) {
+				Ref<LuaError> err = LuaError::newError(msg, type);
+				err->setTrace(trace);
+				return err;
+			}
+			msg += "\n";
+			if (type == LuaError::ERR_EXECUTION_LIMIT) {
+				return LuaError::newError(msg, type);
+			}
 			break;
 		}
 		case LUA_ERRSYNTAX: {
@@ -571,10 +978,13 @@ Ref<LuaError> LuaState::handleError(lua_State *state, int lua_error) {
 		}
 		case LUA_ERRMEM: {
 			msg += "[LUA_ERRMEM - memory allocation error ]\n";
+			// Frames the handler captured before running out of memory belong to no error
+			getAPI(state)->getPendingTrace().clear();
 			break;
 		}
 		case LUA_ERRERR: {
 			msg += "[LUA_ERRERR - error while calling LuaState::luaErrorHandler ] please report this issue: https://github.com/WeaselGames/lua/issues/new\n";
+			getAPI(state)->getPendingTrace().clear();
 			break;
 		}
 		case LUA_ERRFILE: {
@@ -688,12 +1098,107 @@ Ref<LuaError> LuaState::handleError(const StringName &func, GDExtensionCallError
 
 // Lua error handler, when a error occurs it appends the stacktrace to the error message
 int LuaState::luaErrorHandler(lua_State *state) {
+	LuaAPI *api = getAPI(state);
+	switch (api->getTracebackMode()) {
+		case LuaAPI::TRACEBACK_NONE:
+			return 1;
+		case LuaAPI::TRACEBACK_LAZY:
+			captureTrace(state, api->getPendingTrace());
+			return 1;
+		default:
+			break;
+	}
+
 	const char *msg = lua_tostring(state, -1);
 	luaL_traceback(state, state, msg, 2);
 	lua_remove(state, -2);
 	return 1;
 }
 
+// Copies the raw frames luaL_traceback would print, LuaError formats them when the message is first read.
+void LuaState::captureTrace(lua_State *state, Vector<LuaError::TraceFrame> &frames) {
+	frames.clear();
+
+	lua_Debug ar;
+	for (int level = 2; frames.size() < MAX_TRACE_FRAMES && lua_getstack(state, level, &ar); level++) {
+		lua_getinfo(state, "Sln", &ar);
+
+		LuaError::TraceFrame frame;
+		memcpy(frame.source, ar.short_src, sizeof(frame.source));
+		frame.source[sizeof(frame.source) - 1] = '\0';
+		frame.line = ar.currentline;
+		frame.lineDefined = ar.linedefined;
+		frame.what = ar.what != nullptr ? ar.what[0] : 0;
+		frame.named = ar.namewhat != nullptr && ar.namewhat[0] != '\0' && ar.name != nullptr;
+		if (frame.named) {
+			strncpy(frame.name, ar.name, sizeof(frame.name) - 1);
+			frame.name[sizeof(frame.name) - 1] = '\0';
+		}
+		frames.push_back(frame);
+	}
+}
+
+// Yielded alone by await, so whoever resumed the thread knows a signal will resume it instead
+static char awaitYieldKey;
+
+// Connects the signal to the whole coroutine with no GDScript in between. Pushes the error message and returns false on failure.
+static bool awaitSignal(lua_State *state) {
+	Variant var = LuaState::getVariant(state, 1);
+	if (var.get_type() != Variant::SIGNAL) {
+		lua_pushstring(state, vformat("await expects a Signal but got '%s'.", Variant::get_type_name(var.get_type())).utf8().get_data());
+		return false;
+	}
+
+	Signal signal = var;
+	LuaAPI *api = LuaState::getAPI(state);
+	lua_pushthread(state);
+	int threadRef = luaL_ref(state, LUA_REGISTRYINDEX);
+	uint64_t token = api->beginAwait(state);
+	// If connecting fails the callable is freed right away, which also undoes the two lines above
+	int err = (int)signal.connect(Callable(memnew(LuaAwaitCallable(api, threadRef, state, token))), Object::CONNECT_ONE_SHOT);
+	if (err != OK) {
+		lua_pushstring(state, vformat("Failed to await signal '%s' (error %d).", String(signal.get_name()), err).utf8().get_data());
+		return false;
+	}
+	return true;
+}
+
+// await(signal), returns the arguments the signal was emitted with
+int LuaState::luaAwait(lua_State *state) {
+	if (lua_pushthread(state) == 1) {
+		return luaL_error(state, "await can only be used inside a coroutine.");
+	}
+	lua_pop(state, 1);
+
+	if (!awaitSignal(state)) {
+		return lua_error(state);
+	}
+
+	lua_settop(state, 0);
+	lua_pushlightuserdata(state, &awaitYieldKey);
+	return lua_yield(state, 1);
+}
+
+// Runs once await returns, with the values the thread was resumed with
+int LuaState::luaAwaitFinish(lua_State *state) {
+	getAPI(state)->finishAwait(state);
+	return lua_gettop(state);
+}
+
+// True if the values a resume returned are from await
+bool LuaState::isAwaitYield(lua_State *state, int nresults) {
+	return nresults == 1 && lua_touserdata(state, -1) == &awaitYieldKey;
+}
+
+// coroutine.running, calls the original kept as upvalue 1 and marks the running thread as reachable from Lua
+int LuaState::luaCoroutineRunning(lua_State *state) {
+	lua_settop(state, 0);
+	lua_pushvalue(state, lua_upvalueindex(1));
+	lua_call(state, 0, LUA_MULTRET);
+	getAPI(state)->exposeThread(state);
+	return lua_gettop(state);
+}
+
 // Change lua's print function to print to the Godot console by default
 int LuaState::luaPrint(lua_State *state) {
 	int args = lua_gettop(state);
@@ -728,209 +1233,183 @@ int LuaState::luaPrint(lua_State *state) {
 	return 0;
 }
 
-#ifndef LAPI_GDEXTENSION
-
-#include <vector>
-
 // Used as the __call metamethod for mt_Callable.
 // All exposed gdscript functions are called vis this method.
 int LuaState::luaCallableCall(lua_State *state) {
-	int argc = lua_gettop(state) - 1; // We subtract 1 because the callable its self will be counted
-	Callable callable = (Callable)LuaState::getVariant(state, 1);
-
-	Array args;
-	args.resize(argc);
-	Vector<const Variant *> mem_args;
-	mem_args.resize(argc);
-
-	int index = 2; // we start at 2, 1 is the callable
-	for (int i = 0; i < argc; i++) {
-		args[i] = LuaState::getVariant(state, index++);
-		if (args[i].get_type() != Variant::Type::OBJECT) {
-			if (Ref<LuaError> err = Object::cast_to<LuaError>(args[i].operator Object *()); !err.is_null()) {
-				lua_pushstring(state, err->getMessage().utf8().get_data());
-				lua_error(state);
-				return 0;
-			}
-		}
-
-		mem_args.write[i] = &args[i];
-	}
-
-	const Variant **p_args = (const Variant **)mem_args.ptr();
-
-	Variant returned;
-	Callable::CallError error;
-	callable.callp(p_args, argc, returned, error);
-	if (error.error != error.CALL_OK) {
-		Ref<LuaError> err = LuaState::handleError(callable.get_method(), error, p_args, argc);
-		lua_pushstring(state, err->getMessage().utf8().get_data());
-		lua_error(state);
-		return 0;
+	int ret = callableCall(state);
+	if (ret == CALL_ERROR) {
+		return lua_error(state);
 	}
-
-	// await was called, so yield
-	if (returned.is_ref_counted() && (returned.operator Object *())->get_class_name() == "GDScriptFunctionState") {
+	if (ret == CALL_YIELD) {
 		return lua_yield(state, lua_gettop(state));
 	}
-
-	Ref<LuaError> err = LuaState::pushVariant(state, returned);
-	if (!err.is_null()) {
-		lua_pushstring(state, err->getMessage().utf8().get_data());
-		lua_error(state);
-		return 0;
-	}
-
-	if (returned.get_type() != Variant::Type::OBJECT) {
-		return 1;
-	}
-
-	if (LuaTuple *tuple = Object::cast_to<LuaTuple>(returned.operator Object *()); tuple != nullptr) {
-		return tuple->size();
-	}
-	return 1;
+	return ret;
 }
 
-#else
-
-int LuaState::luaCallableCall(lua_State *state) {
+// Does the work for luaCallableCall, see callNative for the return value.
+int LuaState::callableCall(lua_State *state) {
 	int argc = lua_gettop(state) - 1; // We subtract 1 because the callable its self will be counted
-	Callable callable = (Callable)LuaState::getVariant(state, 1);
+	Variant callable = LuaState::getVariant(state, 1);
 
-	Array args;
+	LuaCallArgs args(argc);
 	int index = 2; // we start at 2, 1 is the callable
 	for (int i = 0; i < argc; i++) {
-		Variant var = LuaState::getVariant(state, index++);
-		if (var.get_type() == Variant::Type::OBJECT) {
-			if (Ref<LuaError> err = dynamic_cast<LuaError *>(var.operator Object *()); !err.is_null()) {
+		args[i] = LuaState::getVariant(state, index++);
+		if (args[i].get_type() == Variant::Type::OBJECT) {
+#ifndef LAPI_GDEXTENSION
+			if (LuaError *err = Object::cast_to<LuaError>(args[i].operator Object *()); err != nullptr) {
+#else
+			// blame this on https://github.com/godotengine/godot-cpp/issues/995
+			if (LuaError *err = dynamic_cast<LuaError *>(args[i].operator Object *()); err != nullptr) {
+#endif
 				lua_pushstring(state, err->getMessage().utf8().get_data());
-				lua_error(state);
-				return 0;
+				return CALL_ERROR;
 			}
 		}
-
-		args.append(var);
-	}
-
-	Variant returned = callable.callv(args);
-	// await was called, so yield
-	if (returned.get_type() == Variant::OBJECT && (returned.operator Object *())->get_class() == "GDScriptFunctionState") {
-		return lua_yield(state, lua_gettop(state));
 	}
 
-	Ref<LuaError> err = LuaState::pushVariant(state, returned);
-	if (!err.is_null()) {
-		lua_pushstring(state, err->getMessage().utf8().get_data());
-		lua_error(state);
-		return 0;
-	}
-
-	if (returned.get_type() != Variant::Type::OBJECT)
-		return 1;
-	if (LuaTuple *tuple = dynamic_cast<LuaTuple *>(returned.operator Object *()); tuple != nullptr)
-		return tuple->size();
-	return 1;
+	return callNative(state, callable, StringName(), args);
 }
 
-#endif
-
 // This function is invoked whenever a function is called on one of the userdata types
 // excluding mt_Callable or mt_Object if __index is overwritten
 int LuaState::luaUserdataFuncCall(lua_State *state) {
+	int ret = userdataFuncCall(state);
+	if (ret == CALL_ERROR) {
+		return lua_error(state);
+	}
+	if (ret == CALL_YIELD) {
+		return lua_yield(state, lua_gettop(state));
+	}
+	return ret;
+}
+
+// Does the work for luaUserdataFuncCall, see callNative for the return value.
+int LuaState::userdataFuncCall(lua_State *state) {
 	Variant *obj = (Variant *)lua_touserdata(state, lua_upvalueindex(1));
-	String fName = LuaState::getVariant(state, lua_upvalueindex(2));
+	StringName fName = LuaState::getVariant(state, lua_upvalueindex(2));
 
 	int argc = lua_gettop(state);
-	Array args;
-	args.resize(argc);
-	Vector<const Variant *> mem_args;
-	mem_args.resize(argc);
+	LuaCallArgs args(argc);
 	for (int i = 0; i < argc; i++) {
 		args[i] = LuaState::getVariant(state, i + 1);
-		mem_args.write[i] = &args[i];
 	}
 
-	const Variant **p_args = (const Variant **)mem_args.ptr();
+	return callNative(state, *obj, fName, args);
+}
 
+// Shared trampoline for calls from Lua into Godot. Calls target.method, or target itself when it is a Callable and method is empty, then pushes the results.
+// Returns the number of results, CALL_YIELD if the function awaited or CALL_ERROR with the message on top of the stack.
+// Errors and yields are left to the caller so they are raised after every local, including args, has been destroyed.
+int LuaState::callNative(lua_State *state, Variant &target, const StringName &method, LuaCallArgs &args, const ReturnSignature *returnSignature) {
 	Variant returned;
+	LuaAPI *api = getAPI(state);
+	LuaAPI::NativeCall previous = api->beginNativeCall(state);
 #ifndef LAPI_GDEXTENSION
 	Callable::CallError error;
-	obj->callp(fName.utf8().get_data(), p_args, argc, returned, error);
-	if (error.error != error.CALL_OK) {
-		Ref<LuaError> err = LuaState::handleError(fName, error, p_args, argc);
-		lua_pushstring(state, err->getMessage().utf8().get_data());
-		lua_error(state);
-		return 0;
+	if (method.is_empty()) {
+		Callable callable = target;
+		callable.callp(args.ptr(), args.size(), returned, error);
+	} else {
+		target.callp(method, args.ptr(), args.size(), returned, error);
 	}
+	bool failed = error.error != Callable::CallError::CALL_OK;
 #else
+	// Going through Variant::callp avoids building the Array Callable::callv needs
+	static const StringName callName = "call";
 	GDExtensionCallError error;
-	obj->callp(fName.utf8().get_data(), p_args, argc, returned, error);
-	if (error.error != GDEXTENSION_CALL_OK) {
-		Ref<LuaError> err = LuaState::handleError(fName, error, p_args, argc);
+	if (method.is_empty()) {
+		target.callp(callName, args.ptr(), args.size(), returned, error);
+	} else {
+		target.callp(method, args.ptr(), args.size(), returned, error);
+	}
+	bool failed = error.error != GDEXTENSION_CALL_OK;
+#endif
+	int pushed = api->endNativeCall(previous);
+
+	if (failed) {
+		StringName name = method.is_empty() ? target.operator Callable().get_method() : method;
+		Ref<LuaError> err = LuaState::handleError(name, error, args.ptr(), args.size());
 		lua_pushstring(state, err->getMessage().utf8().get_data());
-		lua_error(state);
-		return 0;
+		return CALL_ERROR;
+	}
+
+	Object *obj = returned.get_type() == Variant::Type::OBJECT ? returned.operator Object *() : nullptr;
+	// await was called, so yield
+#ifndef LAPI_GDEXTENSION
+	// Compared as a StringName so returning an object does not build a String every call
+	static const StringName functionStateName = "GDScriptFunctionState";
+	if (obj != nullptr && obj->get_class_name() == functionStateName) {
+		return CALL_YIELD;
+	}
+#else
+	if (obj != nullptr && obj->get_class() == "GDScriptFunctionState") {
+		return CALL_YIELD;
 	}
 #endif
 
+	// The values passed to LuaAPI.return_values are already on the stack
+	if (pushed > 0) {
+		return pushed;
+	}
+
+	if (returnSignature != nullptr) {
+		if (!returnSignature->push(state, returnSignature->type, returned)) {
+			StringName name = method.is_empty() ? target.operator Callable().get_method() : method;
+			lua_pushstring(state, vformat("Error calling function: %s - Invalid return type, expected %s but is %s.", String(name), Variant::get_type_name(returnSignature->type), Variant::get_type_name(returned.get_type())).utf8().get_data());
+			return CALL_ERROR;
+		}
+		return 1;
+	}
+
+	// A returned LuaError would be raised by pushVariant itself, skipping the destructors of the callers locals
+	Ref<LuaError> err = LuaState::checkPushable(returned);
+	if (err.is_valid()) {
+		lua_pushstring(state, err->getMessage().utf8().get_data());
+		return CALL_ERROR;
+	}
 	LuaState::pushVariant(state, returned);
-	if (returned.get_type() != Variant::Type::OBJECT) {
+
+	if (obj == nullptr) {
 		return 1;
 	}
 
 #ifndef LAPI_GDEXTENSION
-	if (LuaTuple *tuple = Object::cast_to<LuaTuple>(returned.operator Object *()); tuple != nullptr) {
+	if (LuaTuple *tuple = Object::cast_to<LuaTuple>(obj); tuple != nullptr) {
 #else
 	// blame this on https://github.com/godotengine/godot-cpp/issues/995
-	if (LuaTuple *tuple = dynamic_cast<LuaTuple *>(returned.operator Object *()); tuple != nullptr) {
+	if (LuaTuple *tuple = dynamic_cast<LuaTuple *>(obj); tuple != nullptr) {
 #endif
 		return tuple->size();
 	}
 	return 1;
 }
 
+// The only hook function set on any thread. Count events check the execution limit and the running LuaJob first, the rest is up to LuaAPI::dispatchHook.
 void LuaState::luaHook(lua_State *state, lua_Debug *ar) {
-	lua_pushstring(state, "__HOOK");
-	lua_rawget(state, LUA_REGISTRYINDEX);
-	Callable hook = LuaState::getVariant(state, -1);
-	lua_pop(state, 1);
-
-	if (hook.is_null()) {
-		return;
-	}
-
-	Array args;
-	args.append(Ref<LuaAPI>(getAPI(state)));
-	args.append(ar->event);
-	args.append(ar->currentline);
-
-#ifndef LAPI_GDEXTENSION
-	const int argc = 3;
-	const Variant *p_args[argc];
-	for (int i = 0; i < argc; i++) {
-		p_args[i] = &args[i];
-	}
-
-	Variant returned;
-	Callable::CallError error;
-	hook.callp(p_args, argc, returned, error);
-	if (error.error != error.CALL_OK) {
-		Ref<LuaError> err = LuaState::handleError(hook.get_method(), error, p_args, argc);
-		lua_pushstring(state, err->getMessage().utf8().get_data());
+	LuaAPI *api = getAPI(state);
+	LuaAPI::LimitAction action = ar->event == LUA_HOOKCOUNT ? api->checkExecutionLimit(state, lua_gethookcount(state)) : api->checkInterrupt(state, false);
+	if (action == LuaAPI::LIMIT_RAISE) {
+		lua_pushstring(state, api->executionInterrupted() ? "interrupted" : "execution limit exceeded");
 		lua_error(state);
 		return;
 	}
 
-	if (returned.get_type() == Variant::NIL) {
-		return;
+	if (ar->event == LUA_HOOKCOUNT) {
+		// Hooks may only yield without values
+		if (action == LuaAPI::LIMIT_YIELD) {
+			lua_yield(state, 0);
+			return;
+		}
+
+		LuaJob *job = api->getRunningJob();
+		if (job != nullptr && job->shouldPreempt(state)) {
+			lua_yield(state, 0);
+			return;
+		}
 	}
-#else
-	Variant returned = hook.callv(args);
-#endif
 
-	Ref<LuaError> err = LuaState::pushVariant(state, returned);
-	if (!err.is_null()) {
-		lua_pushstring(state, err->getMessage().utf8().get_data());
+	if (!api->dispatchHook(state, ar)) {
 		lua_error(state);
 	}
 }
@@ -3,9 +3,13 @@
 
 #ifndef LAPI_GDEXTENSION
 #include "core/object/ref_counted.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/local_vector.h"
 #include "core/variant/callable.h"
 #else
 #include <godot_cpp/classes/ref.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
 #include <godot_cpp/templates/vector.hpp>
 #include <godot_cpp/templates/vmap.hpp>
 #endif
@@ -16,23 +20,33 @@
 #define METATABLE_DISCLAIMER "This metatable is protected."
 
 class LuaAPI;
+class LuaCallArgs;
 
 class LuaState {
 public:
 	void setState(lua_State *state, LuaAPI *lua, bool bindAPI);
 	void setHook(Callable hook, int mask, int count);
+	void setHookFilter(Dictionary breakpoints, PackedStringArray functions);
 
 	bool luaFunctionExists(String functionName);
 
 	lua_State *getState() const;
+	int getErrorHandlerRef() const;
 
 	Variant getVar(int index = -1) const;
 	Variant pullVariant(String name);
+	Array pullVariants(PackedStringArray names);
 	Variant callFunction(String functionName, Array args);
+	Variant getFunctionHandle(String functionName);
+	bool pushGlobalFunction(const String &functionName);
+	bool pushGlobalValue(const String &name, int type);
+	Variant callFunctionBatch(String functionName, Array args, Array results);
+	Ref<LuaError> callFunctionInto(String functionName, Array args, Array results);
 
 	Variant getRegistryValue(String name);
 
 	Ref<LuaError> setRegistryValue(String name, Variant var);
+	Dictionary pushGlobalVariants(Dictionary vars);
 	Ref<LuaError> bindLibraries(TypedArray<String> libs);
 	Ref<LuaError> pushVariant(Variant var) const;
 	Ref<LuaError> pushGlobalVariant(String name, Variant var);
@@ -41,6 +55,7 @@ public:
 	static LuaAPI *getAPI(lua_State *state);
 
 	static Ref<LuaError> pushVariant(lua_State *state, Variant var);
+	static Ref<LuaError> checkPushable(const Variant &var);
 	static Ref<LuaError> handleError(lua_State *state, int lua_error);
 #ifndef LAPI_GDEXTENSION
 	static Ref<LuaError> handleError(const StringName &func, Callable::CallError error, const Variant **p_arguments, int argc);
@@ -48,19 +63,51 @@ public:
 	static Ref<LuaError> handleError(const StringName &func, GDExtensionCallError error, const Variant **p_arguments, int argc);
 #endif
 	static Variant getVariant(lua_State *state, int index);
+	static void readResults(lua_State *state, int index, Array &results);
 
 	// Lua functions
 	static int luaErrorHandler(lua_State *state);
 	static int luaPrint(lua_State *state);
+	static int luaCoroutineRunning(lua_State *state);
+	static int luaAwait(lua_State *state);
+	static int luaAwaitFinish(lua_State *state);
+	static bool isAwaitYield(lua_State *state, int nresults);
 	static int luaUserdataFuncCall(lua_State *state);
 	static int luaCallableCall(lua_State *state);
 
 	static void luaHook(lua_State *state, lua_Debug *ar);
 
+	// Results of callNative besides a result count
+	enum {
+		CALL_ERROR = -1,
+		CALL_YIELD = -2,
+	};
+
+	// Declared return type of a call, lets callNative skip the generic pushVariant. See LuaCallableExtra::withSignature
+	struct ReturnSignature {
+		Variant::Type type = Variant::NIL;
+		bool (*push)(lua_State *state, Variant::Type type, const Variant &value) = nullptr; // Returns false if value is not of the declared type
+	};
+
+	static int callNative(lua_State *state, Variant &target, const StringName &method, LuaCallArgs &args, const ReturnSignature *returnSignature = nullptr);
+
 private:
 	lua_State *L = nullptr;
+	LuaAPI *api = nullptr;
+	int errorHandlerRef = LUA_NOREF; // luaErrorHandler, shared by every function handle
+
+	static const uint32_t MAX_TRACE_FRAMES = 22; // Roughly what luaL_traceback prints before eliding
+	static void captureTrace(lua_State *state, Vector<LuaError::TraceFrame> &frames);
 
 	// Helper functions for recursive indexing
+	static int callableCall(lua_State *state);
+	static int userdataFuncCall(lua_State *state);
+
+	// Dotted names split into UTF-8 keys, so names synced every frame are only split once
+	static const int MAX_CACHED_PATHS = 1024;
+	HashMap<String, LocalVector<CharString>> pathCache;
+	const LocalVector<CharString> &getPath(const String &name);
+
 	void indexForReading(String name); // Puts the object on the stack
 	String indexForWriting(String name); // Puts the table on the stack and gives the last name. (Please make sure the table is not nil.)
 
@@ -74,6 +121,8 @@ private:
 	void createObjectMetatable();
 	void createCallableMetatable();
 	void createCallableExtraMetatable();
+	void createPropertyAccessorMetatable();
+	void createNodeIteratorMetatable();
 };
 
 #endif
@@ -1,10 +1,21 @@
 #include "luaState.h"
 
 #include <classes/luaAPI.h>
+#include <classes/luaCallable.h>
 #include <classes/luaCallableExtra.h>
 #include <classes/luaObjectMetatable.h>
 #include <classes/luaTuple.h>
 
+#include <luaCallArgs.h>
+
+#ifndef LAPI_GDEXTENSION
+#include "scene/main/node.h"
+#include "scene/main/scene_tree.h"
+#else
+#include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/classes/scene_tree.hpp>
+#endif
+
 // These 2 macros helps us in constructing general metamethods.
 // We can use "lua" as a "Lua" pointer and arg1, arg2, ..., arg5 as Variants objects
 // Check examples in createVector2Metatable
@@ -23,6 +34,14 @@
 	lua_pushcfunction(lua_state, LUA_LAMBDA_TEMPLATE(_f_));                       \
 	lua_settable(lua_state, metatable_index - 2);
 
+static size_t getUserdataSize(lua_State *state, int index) {
+#ifndef LAPI_LUAJIT
+	return lua_rawlen(state, index);
+#else
+	return lua_objlen(state, index);
+#endif
+}
+
 // Expose the default constructors
 void LuaState::exposeConstructors() {
 	lua_pushcfunction(L, LUA_LAMBDA_TEMPLATE({
@@ -381,11 +400,199 @@ void LuaState::createColorMetatable() {
 	lua_pop(L, 1); // Stack is now unmodified
 }
 
+// Handle returned by signal:connect. Holds the Callable so disconnecting does not have to wrap the Lua function again.
+struct LuaSignalConnection {
+	Signal signal;
+	Callable callable;
+};
+
+// Lua functions become LuaCallables sharing the functions registry ref, anything else must already be a Callable.
+// Returns false with the message pushed.
+static bool toCallable(lua_State *state, int index, Callable &r_callable) {
+	if (lua_type(state, index) == LUA_TFUNCTION) {
+		// Bound to the main state, the thread connecting may be gone by the time the signal fires
+		LuaAPI *api = LuaState::getAPI(state);
+		lua_State *mainState = api->getState();
+		lua_pushvalue(state, index);
+		if (mainState != state) {
+			lua_xmove(state, mainState, 1);
+		}
+		r_callable = Callable(memnew(LuaCallable(Ref<LuaAPI>(api), api->acquireFunctionRef(mainState, -1), lua_topointer(mainState, -1), mainState)));
+		lua_pop(mainState, 1);
+		return true;
+	}
+
+	Variant var = LuaState::getVariant(state, index);
+	if (var.get_type() != Variant::CALLABLE) {
+		lua_pushstring(state, vformat("Expected a function or Callable but got '%s'.", Variant::get_type_name(var.get_type())).utf8().get_data());
+		return false;
+	}
+
+	r_callable = var;
+	return true;
+}
+
+// The closures below have the Signal userdata as upvalue 1 and work with both signal.connect(f) and signal:connect(f).
+static int signalArgsStart(lua_State *state) {
+	return lua_touserdata(state, 1) == lua_touserdata(state, lua_upvalueindex(1)) ? 2 : 1;
+}
+
+// Only a bad argument raises. Like Signal.connect a duplicate or failed connect returns the error code,
+// so scripts written against the generic method call keep working.
+static bool signalConnect(lua_State *state, int first, int flags) {
+	Signal signal = *(Variant *)lua_touserdata(state, lua_upvalueindex(1));
+	Callable callable;
+	if (!toCallable(state, first, callable)) {
+		return false;
+	}
+
+	if (signal.is_connected(callable)) {
+		lua_pushinteger(state, ERR_INVALID_PARAMETER);
+		return true;
+	}
+
+	int err = (int)signal.connect(callable, flags);
+	if (err != OK) {
+		lua_pushinteger(state, err);
+		return true;
+	}
+
+	LuaSignalConnection *connection = (LuaSignalConnection *)lua_newuserdata(state, sizeof(LuaSignalConnection));
+	memnew_placement(connection, LuaSignalConnection);
+	connection->signal = signal;
+	connection->callable = callable;
+	luaL_setmetatable(state, "mt_SignalConnection");
+	return true;
+}
+
+static int luaSignalConnect(lua_State *state) {
+	int first = signalArgsStart(state);
+	int flags = (int)luaL_optinteger(state, first + 1, 0);
+	if (!signalConnect(state, first, flags)) {
+		return lua_error(state);
+	}
+	return 1;
+}
+
+// Returns 1 if the function was connected, 0 if not and -1 with the message pushed on error.
+static int signalDisconnect(lua_State *state, int first, bool disconnect) {
+	Signal signal = *(Variant *)lua_touserdata(state, lua_upvalueindex(1));
+	Callable callable;
+	if (!toCallable(state, first, callable)) {
+		return -1;
+	}
+
+	if (!signal.is_connected(callable)) {
+		return 0;
+	}
+
+	if (disconnect) {
+		signal.disconnect(callable);
+	}
+	return 1;
+}
+
+static int luaSignalDisconnect(lua_State *state) {
+	int ret = signalDisconnect(state, signalArgsStart(state), true);
+	if (ret < 0) {
+		return lua_error(state);
+	}
+	lua_pushboolean(state, ret);
+	return 1;
+}
+
+static int luaSignalIsConnected(lua_State *state) {
+	int ret = signalDisconnect(state, signalArgsStart(state), false);
+	if (ret < 0) {
+		return lua_error(state);
+	}
+	lua_pushboolean(state, ret);
+	return 1;
+}
+
+// Arguments go straight from the Lua stack into the emit call without building an Array.
+static bool signalEmit(lua_State *state, int first) {
+	Variant *self = (Variant *)lua_touserdata(state, lua_upvalueindex(1));
+	int argc = lua_gettop(state) - first + 1;
+	LuaCallArgs args(argc);
+	for (int i = 0; i < argc; i++) {
+		args[i] = LuaState::getVariant(state, first + i);
+	}
+
+#ifndef LAPI_GDEXTENSION
+	Signal signal = *self;
+	Error err = signal.emit(args.ptr(), args.size());
+	if (err != OK) {
+		lua_pushstring(state, vformat("Failed to emit signal '%s' (error %d).", String(signal.get_name()), err).utf8().get_data());
+		return false;
+	}
+#else
+	static const StringName emitName = "emit";
+	Variant returned;
+	GDExtensionCallError error;
+	self->callp(emitName, args.ptr(), args.size(), returned, error);
+	if (error.error != GDEXTENSION_CALL_OK) {
+		lua_pushstring(state, vformat("Failed to emit signal '%s'.", String(self->operator Signal().get_name())).utf8().get_data());
+		return false;
+	}
+#endif
+	return true;
+}
+
+static int luaSignalEmit(lua_State *state) {
+	if (!signalEmit(state, signalArgsStart(state))) {
+		return lua_error(state);
+	}
+	return 0;
+}
+
+static lua_CFunction getSignalMethod(const char *name) {
+	if (name == nullptr) {
+		return nullptr;
+	}
+	if (strcmp(name, "connect") == 0) {
+		return luaSignalConnect;
+	}
+	if (strcmp(name, "emit") == 0) {
+		return luaSignalEmit;
+	}
+	if (strcmp(name, "disconnect") == 0) {
+		return luaSignalDisconnect;
+	}
+	if (strcmp(name, "is_connected") == 0) {
+		return luaSignalIsConnected;
+	}
+	return nullptr;
+}
+
+static int luaSignalConnectionDisconnect(lua_State *state) {
+	LuaSignalConnection *connection = (LuaSignalConnection *)luaL_checkudata(state, 1, "mt_SignalConnection");
+	bool connected = connection->signal.is_connected(connection->callable);
+	if (connected) {
+		connection->signal.disconnect(connection->callable);
+	}
+	lua_pushboolean(state, connected);
+	return 1;
+}
+
+static int luaSignalConnectionIsConnected(lua_State *state) {
+	LuaSignalConnection *connection = (LuaSignalConnection *)luaL_checkudata(state, 1, "mt_SignalConnection");
+	lua_pushboolean(state, connection->signal.is_connected(connection->callable));
+	return 1;
+}
+
 // Create metatable for Signal and saves it at LUA_REGISTRYINDEX with name "mt_Signal"
 void LuaState::createSignalMetatable() {
 	luaL_newmetatable(L, "mt_Signal");
 
 	LUA_METAMETHOD_TEMPLATE(L, -1, "__index", {
+		// connect, emit, disconnect and is_connected skip the generic method call
+		if (lua_CFunction method = getSignalMethod(lua_tostring(inner_state, 2)); method != nullptr) {
+			lua_pushvalue(inner_state, 1);
+			lua_pushcclosure(inner_state, method, 1);
+			return 1;
+		}
+
 		if (arg1.has_method(arg2.operator String())) {
 			lua_pushlightuserdata(inner_state, lua_touserdata(inner_state, 1));
 			LuaState::pushVariant(inner_state, arg2);
@@ -402,10 +609,95 @@ void LuaState::createSignalMetatable() {
 	lua_settable(L, -3);
 
 	lua_pop(L, 1); // Stack is now unmodified
+
+	// Connection handles only need disconnect and is_connected, so __index is a plain table
+	luaL_newmetatable(L, "mt_SignalConnection");
+
+	lua_pushstring(L, "__gc");
+	lua_pushcfunction(L, [](lua_State *inner_state) -> int {
+		LuaSignalConnection *connection = (LuaSignalConnection *)lua_touserdata(inner_state, 1);
+		connection->~LuaSignalConnection();
+		return 0;
+	});
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "__index");
+	lua_newtable(L);
+	lua_pushcfunction(L, luaSignalConnectionDisconnect);
+	lua_setfield(L, -2, "disconnect");
+	lua_pushcfunction(L, luaSignalConnectionIsConnected);
+	lua_setfield(L, -2, "is_connected");
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "__metatable");
+	lua_pushliteral(L, METATABLE_DISCLAIMER);
+	lua_settable(L, -3);
+
+	lua_pop(L, 1);
+}
+
+// get_node bound to a Node. Upvalue 1 is the node, upvalue 2 the "__NODEPATHS" intern table.
+// Works with both node.get_node(path) and node:get_node(path).
+static int luaNodeGetNode(lua_State *state) {
+	Variant *self = (Variant *)lua_touserdata(state, lua_upvalueindex(1));
+	int pathIndex = lua_touserdata(state, 1) == self ? 2 : 1;
+	const char *path = luaL_checkstring(state, pathIndex);
+	LuaAPI *api = LuaState::getAPI(state);
+
+	// Lua strings are interned, so looking the path up here is a pointer compare rather than a parse
+	lua_pushvalue(state, pathIndex);
+	lua_rawget(state, lua_upvalueindex(2));
+	int pathId = -1;
+	if (lua_isnil(state, -1)) {
+		pathId = api->internNodePath(String::utf8(path));
+		if (pathId >= 0) {
+			lua_pushvalue(state, pathIndex);
+			lua_pushinteger(state, pathId);
+			lua_rawset(state, lua_upvalueindex(2));
+		}
+	} else {
+		pathId = lua_tointeger(state, -1);
+	}
+	lua_pop(state, 1);
+
+	Object *target = nullptr;
+	if (pathId >= 0) {
+		target = api->getNodeCached(self->operator Object *(), pathId);
+	} else if (Node *node = Object::cast_to<Node>(self->operator Object *()); node != nullptr) {
+		target = node->get_node_or_null(NodePath(String::utf8(path)));
+	}
+
+	if (target == nullptr) {
+		lua_pushnil(state);
+	} else {
+		LuaState::pushVariant(state, target);
+	}
+	return 1;
+}
+
+// Replaces the Callable returned for node.get_node with luaNodeGetNode.
+static bool pushFastMethod(lua_State *state, const Variant &obj, const Variant &method) {
+	static const StringName getNode = "get_node";
+	if (method.get_type() != Variant::CALLABLE) {
+		return false;
+	}
+
+	Callable callable = method;
+	if (callable.get_method() != getNode || Object::cast_to<Node>(obj.operator Object *()) == nullptr) {
+		return false;
+	}
+
+	lua_pushvalue(state, 1);
+	lua_getfield(state, LUA_REGISTRYINDEX, "__NODEPATHS");
+	lua_pushcclosure(state, luaNodeGetNode, 2);
+	return true;
 }
 
 // Create metatable for any Object and saves it at LUA_REGISTRYINDEX with name "mt_Object"
 void LuaState::createObjectMetatable() {
+	lua_newtable(L);
+	lua_setfield(L, LUA_REGISTRYINDEX, "__NODEPATHS");
+
 	luaL_newmetatable(L, "mt_Object");
 
 	LUA_METAMETHOD_TEMPLATE(L, -1, "__index", {
@@ -417,7 +709,9 @@ void LuaState::createObjectMetatable() {
 
 		if (mt.is_valid()) {
 			Variant ret = mt->__index(arg1, api, arg2);
-			LuaState::pushVariant(inner_state, ret);
+			if (!pushFastMethod(inner_state, arg1, ret)) {
+				LuaState::pushVariant(inner_state, ret);
+			}
 			return 1;
 		}
 
@@ -467,14 +761,16 @@ void LuaState::createObjectMetatable() {
 
 	LUA_METAMETHOD_TEMPLATE(L, -1, "__gc", {
 		Ref<LuaAPI> api = getAPI(inner_state);
-		Ref<LuaObjectMetatable> mt = arg1.get("lua_metatable");
-		// Sometimes the api ref is cleaned up first, so we need to check for that
-		if (!mt.is_valid() && api.is_valid()) {
-			mt = api->getObjectMetatable();
+		// Objects pushed with report_external_memory carry their size after the Variant
+		if (api.is_valid() && getUserdataSize(inner_state, 1) >= sizeof(Variant) + sizeof(uint64_t)) {
+			api->removeExternalMemory(*(uint64_t *)((Variant *)lua_touserdata(inner_state, 1) + 1));
 		}
 
-		if (mt.is_valid()) {
-			Ref<LuaError> err = mt->__gc(arg1, api);
+		if (api.is_valid() && api->getDeferredFinalization()) {
+			// The queue holds its own ref, the finalizer runs later from LuaAPI::drainFinalizers
+			api->queueFinalizer(arg1);
+		} else {
+			Ref<LuaError> err = LuaAPI::runFinalizer(api, arg1);
 			if (!err.is_null()) {
 				LuaState::pushVariant(inner_state, err);
 			}
@@ -799,6 +1095,363 @@ void LuaState::createObjectMetatable() {
 	lua_pop(L, 1);
 }
 
+// Userdata behind mt_PropertyAccessor. Everything needed to get or set the property is resolved once by prop().
+struct LuaPropertyAccessor {
+	Variant object; // Keeps RefCounted objects alive
+	ObjectID objectID;
+	StringName property;
+	Variant propertyName;
+
+	// Only set when the objects metatable has to handle the access, e.g. custom metatables or __index overrides
+	Ref<LuaObjectMetatable> metatable;
+
+#ifndef LAPI_GDEXTENSION
+	MethodBind *getter = nullptr;
+	MethodBind *setter = nullptr;
+#endif
+};
+
+// Pushes a new accessor, or an error message if one can not be created.
+static bool pushPropertyAccessor(lua_State *state, const Variant &var, const char *name) {
+	Object *obj = var.operator Object *();
+	if (obj == nullptr) {
+		lua_pushstring(state, "prop() expects a valid object");
+		return false;
+	}
+
+	String property = String::utf8(name);
+	Ref<LuaAPI> api = LuaState::getAPI(state);
+	Ref<LuaObjectMetatable> mt = var.get("lua_metatable");
+	if (!mt.is_valid()) {
+		mt = api->getObjectMetatable();
+	}
+
+	if (!mt.is_valid()) {
+		lua_pushstring(state, vformat("Object of type '%s' has no metatable.", obj->get_class()).utf8().get_data());
+		return false;
+	}
+
+#ifndef LAPI_GDEXTENSION
+	LuaDefaultObjectMetatable *defaultMt = Object::cast_to<LuaDefaultObjectMetatable>(mt.ptr());
+#else
+	// blame this on https://github.com/godotengine/godot-cpp/issues/995
+	LuaDefaultObjectMetatable *defaultMt = dynamic_cast<LuaDefaultObjectMetatable *>(mt.ptr());
+#endif
+
+	// The default metatable only needs to be asked once, anything else is asked on every access.
+	bool direct = defaultMt != nullptr && !obj->has_method("__index") && !obj->has_method("__newindex");
+	if (direct && !defaultMt->isFieldAllowed(obj, property)) {
+		lua_pushstring(state, vformat("Attempt to access field '%s' on object of type '%s' which is not a valid field.", property, obj->get_class()).utf8().get_data());
+		return false;
+	}
+
+	LuaPropertyAccessor *accessor = (LuaPropertyAccessor *)lua_newuserdata(state, sizeof(LuaPropertyAccessor));
+	memnew_placement(accessor, LuaPropertyAccessor);
+	luaL_setmetatable(state, "mt_PropertyAccessor");
+
+	accessor->object = var;
+	accessor->objectID = obj->get_instance_id();
+	accessor->property = property;
+	accessor->propertyName = property;
+	if (!direct) {
+		accessor->metatable = mt;
+		return true;
+	}
+
+#ifndef LAPI_GDEXTENSION
+	// Scripts can intercept gets and sets, and indexed properties need the index passed along. Those go through Object::get/set.
+	if (obj->get_script_instance() == nullptr) {
+		StringName className = obj->get_class_name();
+		if (ClassDB::get_property_index(className, accessor->property) == -1) {
+			accessor->getter = ClassDB::get_method(className, ClassDB::get_property_getter(className, accessor->property));
+			accessor->setter = ClassDB::get_method(className, ClassDB::get_property_setter(className, accessor->property));
+		}
+	}
+#endif
+
+	return true;
+}
+
+// prop(obj, name)
+static int luaPropertyAccessorNew(lua_State *state) {
+	Variant *obj = (Variant *)luaL_checkudata(state, 1, "mt_Object");
+	const char *name = luaL_checkstring(state, 2);
+	if (!pushPropertyAccessor(state, *obj, name)) {
+		return lua_error(state);
+	}
+	return 1;
+}
+
+// accessor:get()
+static int luaPropertyAccessorGet(lua_State *state) {
+	LuaPropertyAccessor *accessor = (LuaPropertyAccessor *)luaL_checkudata(state, 1, "mt_PropertyAccessor");
+	Object *obj = ObjectDB::get_instance(accessor->objectID);
+	if (obj == nullptr) {
+		lua_pushstring(state, "Attempt to get a property of a freed object.");
+		return lua_error(state);
+	}
+
+	Variant ret;
+	if (accessor->metatable.is_valid()) {
+		ret = accessor->metatable->__index(obj, LuaState::getAPI(state), accessor->propertyName);
+	}
+#ifndef LAPI_GDEXTENSION
+	else if (accessor->getter != nullptr) {
+		Callable::CallError error;
+		ret = accessor->getter->call(obj, nullptr, 0, error);
+	}
+#endif
+	else {
+		ret = obj->get(accessor->property);
+	}
+
+	LuaState::pushVariant(state, ret);
+	return 1;
+}
+
+// Sets the property and returns an error message, or an empty String.
+static String setAccessorProperty(lua_State *state, LuaPropertyAccessor *accessor, Object *obj) {
+	Variant value = LuaState::getVariant(state, 2);
+	if (accessor->metatable.is_valid()) {
+		Ref<LuaError> err = accessor->metatable->__newindex(obj, LuaState::getAPI(state), accessor->propertyName, value);
+		return err.is_null() ? String() : err->getMessage();
+	}
+
+#ifndef LAPI_GDEXTENSION
+	if (accessor->setter != nullptr) {
+		const Variant *args[1] = { &value };
+		Callable::CallError error;
+		accessor->setter->call(obj, args, 1, error);
+		if (error.error != Callable::CallError::CALL_OK) {
+			Ref<LuaError> err = LuaState::handleError(accessor->setter->get_name(), error, args, 1);
+			return err.is_null() ? String() : err->getMessage();
+		}
+		return String();
+	}
+#endif
+
+	obj->set(accessor->property, value);
+	return String();
+}
+
+// accessor:set(value)
+static int luaPropertyAccessorSet(lua_State *state) {
+	LuaPropertyAccessor *accessor = (LuaPropertyAccessor *)luaL_checkudata(state, 1, "mt_PropertyAccessor");
+	Object *obj = ObjectDB::get_instance(accessor->objectID);
+	if (obj == nullptr) {
+		lua_pushstring(state, "Attempt to set a property of a freed object.");
+		return lua_error(state);
+	}
+
+	String err = setAccessorProperty(state, accessor, obj);
+	if (err.is_empty()) {
+		return 0;
+	}
+
+	lua_pushstring(state, err.utf8().get_data());
+	return lua_error(state);
+}
+
+// Create metatable for property accessors and saves it at LUA_REGISTRYINDEX with name "mt_PropertyAccessor"
+// Also exposes the prop() function which creates them.
+void LuaState::createPropertyAccessorMetatable() {
+	luaL_newmetatable(L, "mt_PropertyAccessor");
+
+	lua_pushstring(L, "__index");
+	lua_newtable(L);
+	lua_pushcfunction(L, luaPropertyAccessorGet);
+	lua_setfield(L, -2, "get");
+	lua_pushcfunction(L, luaPropertyAccessorSet);
+	lua_setfield(L, -2, "set");
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "__gc");
+	lua_pushcfunction(L, [](lua_State *inner_state) -> int {
+		LuaPropertyAccessor *accessor = (LuaPropertyAccessor *)lua_touserdata(inner_state, 1);
+		accessor->~LuaPropertyAccessor();
+		return 0;
+	});
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "__metatable");
+	lua_pushliteral(L, METATABLE_DISCLAIMER);
+	lua_settable(L, -3);
+
+	lua_pop(L, 1);
+
+	lua_register(L, "prop", luaPropertyAccessorNew);
+}
+
+// Userdata behind mt_NodeIterator, used as the upvalue of the step function returned by children() and nodes_in_group().
+struct LuaNodeIterator {
+	ObjectID owner; // children() only
+	LocalVector<ObjectID> nodes; // nodes_in_group() only
+	uint32_t index = 0;
+};
+
+static LuaNodeIterator *newNodeIterator(lua_State *state) {
+	LuaNodeIterator *iterator = (LuaNodeIterator *)lua_newuserdata(state, sizeof(LuaNodeIterator));
+	memnew_placement(iterator, LuaNodeIterator);
+	luaL_setmetatable(state, "mt_NodeIterator");
+	return iterator;
+}
+
+// Asks the objects metatable for the method, so the iterators are only usable where obj.method would be.
+static bool isMethodAccessible(lua_State *state, const Variant &var, const char *method) {
+	Ref<LuaAPI> api = LuaState::getAPI(state);
+	Ref<LuaObjectMetatable> mt = var.get("lua_metatable");
+	if (!mt.is_valid()) {
+		mt = api->getObjectMetatable();
+	}
+
+	if (!mt.is_valid()) {
+		lua_pushstring(state, vformat("Object of type '%s' has no metatable.", var.operator Object *()->get_class()).utf8().get_data());
+		return false;
+	}
+
+	if (mt->__index(var, api, String(method)).get_type() != Variant::NIL) {
+		return true;
+	}
+
+	lua_pushstring(state, vformat("Attempt to access field '%s' on object of type '%s' which is not a valid field.", method, var.operator Object *()->get_class()).utf8().get_data());
+	return false;
+}
+
+// Step function for children(), reads the next child straight from the node.
+static int luaNodeChildrenStep(lua_State *state) {
+	LuaNodeIterator *iterator = (LuaNodeIterator *)lua_touserdata(state, lua_upvalueindex(1));
+	Node *node = Object::cast_to<Node>(ObjectDB::get_instance(iterator->owner));
+	if (node == nullptr || (int)iterator->index >= node->get_child_count()) {
+		return 0;
+	}
+
+	LuaState::pushVariant(state, node->get_child(iterator->index++));
+	return 1;
+}
+
+// Step function for nodes_in_group(), skips nodes freed while iterating.
+static int luaNodesInGroupStep(lua_State *state) {
+	LuaNodeIterator *iterator = (LuaNodeIterator *)lua_touserdata(state, lua_upvalueindex(1));
+	while (iterator->index < iterator->nodes.size()) {
+		Object *obj = ObjectDB::get_instance(iterator->nodes[iterator->index++]);
+		if (obj != nullptr) {
+			LuaState::pushVariant(state, obj);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Pushes the step function for children(), or an error message.
+static bool pushChildrenIterator(lua_State *state, const Variant &var) {
+	Node *node = Object::cast_to<Node>(var.operator Object *());
+	if (node == nullptr) {
+		lua_pushstring(state, "children() expects a Node");
+		return false;
+	}
+
+	if (!isMethodAccessible(state, var, "get_children")) {
+		return false;
+	}
+
+	LuaNodeIterator *iterator = newNodeIterator(state);
+	iterator->owner = node->get_instance_id();
+	lua_pushcclosure(state, luaNodeChildrenStep, 1);
+	return true;
+}
+
+// Pushes the step function for nodes_in_group(), or an error message.
+static bool pushNodesInGroupIterator(lua_State *state, const Variant &var, const char *group) {
+	Variant treeVar = var;
+	SceneTree *tree = Object::cast_to<SceneTree>(var.operator Object *());
+	if (tree == nullptr) {
+		Node *node = Object::cast_to<Node>(var.operator Object *());
+		if (node == nullptr) {
+			lua_pushstring(state, "nodes_in_group() expects a SceneTree or a Node");
+			return false;
+		}
+
+		if (!isMethodAccessible(state, var, "get_tree")) {
+			return false;
+		}
+
+		if (!node->is_inside_tree()) {
+			lua_pushstring(state, "nodes_in_group() was passed a Node which is not inside a SceneTree");
+			return false;
+		}
+
+		tree = node->get_tree();
+		treeVar = tree;
+	}
+
+	if (!isMethodAccessible(state, treeVar, "get_nodes_in_group")) {
+		return false;
+	}
+
+	LuaNodeIterator *iterator = newNodeIterator(state);
+	// Only the ids are kept, each node gets its userdata when the loop reaches it
+#ifndef LAPI_GDEXTENSION
+	List<Node *> nodes;
+	tree->get_nodes_in_group(StringName(String::utf8(group)), &nodes);
+	iterator->nodes.reserve(nodes.size());
+	for (Node *node : nodes) {
+		iterator->nodes.push_back(node->get_instance_id());
+	}
+#else
+	TypedArray<Node> nodes = tree->get_nodes_in_group(StringName(String::utf8(group)));
+	iterator->nodes.reserve(nodes.size());
+	for (int i = 0; i < nodes.size(); i++) {
+		iterator->nodes.push_back(nodes[i].operator Object *()->get_instance_id());
+	}
+#endif
+
+	lua_pushcclosure(state, luaNodesInGroupStep, 1);
+	return true;
+}
+
+// for child in children(node) do
+static int luaNodeChildren(lua_State *state) {
+	Variant *var = (Variant *)luaL_checkudata(state, 1, "mt_Object");
+	if (!pushChildrenIterator(state, *var)) {
+		return lua_error(state);
+	}
+	return 1;
+}
+
+// for enemy in nodes_in_group(tree_or_node, group) do
+static int luaNodesInGroup(lua_State *state) {
+	Variant *var = (Variant *)luaL_checkudata(state, 1, "mt_Object");
+	const char *group = luaL_checkstring(state, 2);
+	if (!pushNodesInGroupIterator(state, *var, group)) {
+		return lua_error(state);
+	}
+	return 1;
+}
+
+// Create metatable for node iterators and saves it at LUA_REGISTRYINDEX with name "mt_NodeIterator"
+// Also exposes the children() and nodes_in_group() functions which create them.
+void LuaState::createNodeIteratorMetatable() {
+	luaL_newmetatable(L, "mt_NodeIterator");
+
+	lua_pushstring(L, "__gc");
+	lua_pushcfunction(L, [](lua_State *inner_state) -> int {
+		LuaNodeIterator *iterator = (LuaNodeIterator *)lua_touserdata(inner_state, 1);
+		iterator->~LuaNodeIterator();
+		return 0;
+	});
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "__metatable");
+	lua_pushliteral(L, METATABLE_DISCLAIMER);
+	lua_settable(L, -3);
+
+	lua_pop(L, 1);
+
+	lua_register(L, "children", luaNodeChildren);
+	lua_register(L, "nodes_in_group", luaNodesInGroup);
+}
+
 // Create metatable for any Callable and saves it at LUA_REGISTRYINDEX with name "mt_Callable"
 void LuaState::createCallableMetatable() {
 	luaL_newmetatable(L, "mt_Callable");
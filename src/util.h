@@ -2,13 +2,27 @@
 #define UTIL_H
 
 #ifndef LAPI_GDEXTENSION
+#include <core/os/os.h>
 #include <core/string/print_string.h>
+
+inline uint64_t get_ticks_usec() {
+	return OS::get_singleton()->get_ticks_usec();
+}
 #else
+#include <godot_cpp/classes/time.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 using namespace godot;
 
 inline void print_line(const Variant &v) {
 	UtilityFunctions::print(v);
 }
+
+inline void print_error(const Variant &v) {
+	UtilityFunctions::printerr(v);
+}
+
+inline uint64_t get_ticks_usec() {
+	return Time::get_singleton()->get_ticks_usec();
+}
 #endif
 #endif